@@ -4,6 +4,9 @@
 
 #include "ofxOpenGLPrimitives/Util.h"
 #include "ofxOpenGLPrimitives/Object.h"
+#include "ofxOpenGLPrimitives/GeometryImage.h"
+#include "ofxOpenGLPrimitives/UploadQueue.h"
+#include "ofxOpenGLPrimitives/ReadbackQueue.h"
 #include "ofxOpenGLPrimitives/Texture.h"
 #include "ofxOpenGLPrimitives/RenderBuffer.h"
 #include "ofxOpenGLPrimitives/FrameBuffer.h"
@@ -13,6 +16,13 @@
 #include "ofxOpenGLPrimitives/VertexAttributeComponent.h"
 #include "ofxOpenGLPrimitives/VertexAttribute.h"
 #include "ofxOpenGLPrimitives/Geometry.h"
+#include "ofxOpenGLPrimitives/ClusteredGeometry.h"
+#include "ofxOpenGLPrimitives/LODGeometry.h"
+#include "ofxOpenGLPrimitives/GeometryArena.h"
+#include "ofxOpenGLPrimitives/DrawBatch.h"
+#include "ofxOpenGLPrimitives/CullingPass.h"
+#include "ofxOpenGLPrimitives/SceneBVH.h"
+#include "ofxOpenGLPrimitives/TransformFeedback.h"
 #include "ofxOpenGLPrimitives/Program.h"
 #include "ofxOpenGLPrimitives/ShaderLoader.h"
 #include "ofxOpenGLPrimitives/RendererCapability.h"
@@ -0,0 +1,225 @@
+#pragma once
+
+#include "ofxOpenGLPrimitives/Geometry.h"
+#include "ofxOpenGLPrimitives/MeshOptimizer.h"
+
+OFX_OPENGL_PRIMITIVES_BEGIN_NAMESPACE
+
+#pragma mark - ClusteredGeometry
+
+// splits the triangles of a Geometry_ into meshlets (small clusters of at
+// most 64 vertices / 124 triangles) with a bounding sphere and a normal
+// cone each. cull() tests them against the frustum and the camera on the
+// cpu and draw() submits the survivors as index sub-ranges.
+//
+//	geom.begin(GL_TRIANGLES);
+//	...
+//	clusters.build(geom);
+//	geom.end();
+//
+//	clusters.cull(cam.getGlobalPosition(), planes);
+//	clusters.draw();
+template <typename Geometry>
+class ClusteredGeometry
+{
+public:
+	OFX_OPENGL_PRIMITIVES_DEFINE_REFERENCE(ClusteredGeometry);
+	
+	ClusteredGeometry() : geometry(NULL), num_visible(0) {}
+	
+	// rewrites the indices of `geometry` into a plain triangle list grouped
+	// by meshlet. call between the last vertex() and end().
+	bool build(Geometry& geometry, size_t max_vertices = 64, size_t max_triangles = 124);
+	
+	// frustum planes are (a, b, c, d) with inward normals, a sphere is
+	// outside when dot(n, center) + d < -radius. pass NULL to skip.
+	size_t cull(const ofVec3f& camera_position, const ofVec4f* planes = NULL, bool backface = true);
+	
+	// draws the meshlets that passed the last cull()
+	void draw() const;
+	
+	// draws everything, ignoring culling
+	void drawAll() const;
+	
+	size_t getNumClusters() const { return first_index.size(); }
+	size_t getNumVisibleClusters() const { return num_visible; }
+	
+	GLuint getFirstIndex(size_t i) const { return first_index[i]; }
+	GLsizei getNumIndices(size_t i) const { return num_indices[i]; }
+	ofVec3f getCenter(size_t i) const { return ofVec3f(center_x[i], center_y[i], center_z[i]); }
+	float getRadius(size_t i) const { return radius[i]; }
+	ofVec3f getConeAxis(size_t i) const { return ofVec3f(cone_x[i], cone_y[i], cone_z[i]); }
+	float getConeCutoff(size_t i) const { return cone_cutoff[i]; }
+
+protected:
+
+	Geometry* geometry;
+	
+	// per cluster data, one array per field so cull() walks them linearly
+	vector<GLuint> first_index;
+	vector<GLsizei> num_indices;
+	
+	vector<float> center_x, center_y, center_z, radius;
+	vector<float> cone_x, cone_y, cone_z, cone_cutoff;
+	
+	// visible ranges, adjacent clusters are merged
+	vector<GLuint> visible_first;
+	vector<GLsizei> visible_count;
+	size_t num_visible;
+	
+	void clear();
+	void pushVisible(size_t i);
+};
+
+template <typename Geometry>
+inline void ClusteredGeometry<Geometry>::clear()
+{
+	first_index.clear();
+	num_indices.clear();
+	
+	center_x.clear();
+	center_y.clear();
+	center_z.clear();
+	radius.clear();
+	
+	cone_x.clear();
+	cone_y.clear();
+	cone_z.clear();
+	cone_cutoff.clear();
+	
+	visible_first.clear();
+	visible_count.clear();
+	num_visible = 0;
+}
+
+template <typename Geometry>
+inline bool ClusteredGeometry<Geometry>::build(Geometry& geometry, size_t max_vertices, size_t max_triangles)
+{
+	this->geometry = &geometry;
+	clear();
+	
+	vector<GLuint> triangles;
+	if (!geometry.getTriangleList(triangles))
+	{
+		ofLogError("ClusteredGeometry") << "build() needs GL_TRIANGLES";
+		return false;
+	}
+	
+	const vector<ofVec3f>& vertices = geometry.getVertices();
+	if (vertices.empty()) return true;
+	
+	vector<GLuint> offsets;
+	MeshOptimizer::buildMeshlets(offsets, triangles.data(), triangles.size(), vertices.size(),
+								 max_vertices, max_triangles);
+	
+	const size_t num_clusters = offsets.empty() ? 0 : offsets.size() - 1;
+	
+	first_index.reserve(num_clusters);
+	num_indices.reserve(num_clusters);
+	
+	for (size_t i = 0; i < num_clusters; i++)
+	{
+		const GLuint first = offsets[i] * 3;
+		const GLsizei count = (offsets[i + 1] - offsets[i]) * 3;
+		
+		MeshOptimizer::ClusterBounds b = MeshOptimizer::computeClusterBounds(&triangles[first], count,
+																			 vertices[0].getPtr(), sizeof(ofVec3f));
+		
+		first_index.push_back(first);
+		num_indices.push_back(count);
+		
+		center_x.push_back(b.center[0]);
+		center_y.push_back(b.center[1]);
+		center_z.push_back(b.center[2]);
+		radius.push_back(b.radius);
+		
+		cone_x.push_back(b.cone_axis[0]);
+		cone_y.push_back(b.cone_axis[1]);
+		cone_z.push_back(b.cone_axis[2]);
+		cone_cutoff.push_back(b.cone_cutoff);
+	}
+	
+	// meshlets keep the triangle order, so the list can be used as is
+	geometry.setIndices(triangles);
+	
+	for (size_t i = 0; i < num_clusters; i++)
+		pushVisible(i);
+	
+	return true;
+}
+
+template <typename Geometry>
+inline void ClusteredGeometry<Geometry>::pushVisible(size_t i)
+{
+	num_visible++;
+	
+	if (!visible_first.empty()
+		&& visible_first.back() + visible_count.back() == first_index[i])
+	{
+		visible_count.back() += num_indices[i];
+	}
+	else
+	{
+		visible_first.push_back(first_index[i]);
+		visible_count.push_back(num_indices[i]);
+	}
+}
+
+template <typename Geometry>
+inline size_t ClusteredGeometry<Geometry>::cull(const ofVec3f& camera_position, const ofVec4f* planes, bool backface)
+{
+	visible_first.clear();
+	visible_count.clear();
+	num_visible = 0;
+	
+	const size_t num_clusters = first_index.size();
+	
+	for (size_t i = 0; i < num_clusters; i++)
+	{
+		const float cx = center_x[i], cy = center_y[i], cz = center_z[i], r = radius[i];
+		
+		if (planes)
+		{
+			bool outside = false;
+			
+			for (int k = 0; k < 6 && !outside; k++)
+			{
+				const ofVec4f& p = planes[k];
+				outside = p.x * cx + p.y * cy + p.z * cz + p.w < -r;
+			}
+			
+			if (outside) continue;
+		}
+		
+		if (backface && cone_cutoff[i] < 1)
+		{
+			const float dx = cx - camera_position.x;
+			const float dy = cy - camera_position.y;
+			const float dz = cz - camera_position.z;
+			
+			const float d = dx * cone_x[i] + dy * cone_y[i] + dz * cone_z[i];
+			
+			if (d >= cone_cutoff[i] * sqrtf(dx * dx + dy * dy + dz * dz) + r) continue;
+		}
+		
+		pushVisible(i);
+	}
+	
+	return num_visible;
+}
+
+template <typename Geometry>
+inline void ClusteredGeometry<Geometry>::draw() const
+{
+	if (!geometry) return;
+	geometry->drawRanges(visible_first.data(), visible_count.data(), visible_first.size());
+}
+
+template <typename Geometry>
+inline void ClusteredGeometry<Geometry>::drawAll() const
+{
+	if (!geometry) return;
+	geometry->draw();
+}
+
+OFX_OPENGL_PRIMITIVES_END_NAMESPACE
@@ -206,6 +206,31 @@ struct TextureType
 	};
 };
 
+struct BufferMapAccess
+{
+	enum Enum
+	{
+		READ = GL_MAP_READ_BIT,
+		WRITE = GL_MAP_WRITE_BIT,
+		INVALIDATE_RANGE = GL_MAP_INVALIDATE_RANGE_BIT,
+		INVALIDATE_BUFFER = GL_MAP_INVALIDATE_BUFFER_BIT,
+		FLUSH_EXPLICIT = GL_MAP_FLUSH_EXPLICIT_BIT,
+		UNSYNCHRONIZED = GL_MAP_UNSYNCHRONIZED_BIT,
+		PERSISTENT = GL_MAP_PERSISTENT_BIT,
+		COHERENT = GL_MAP_COHERENT_BIT
+	};
+};
+
+struct IndexType
+{
+	enum Enum
+	{
+		AUTO = 0,
+		UNSIGNED_SHORT = GL_UNSIGNED_SHORT,
+		UNSIGNED_INT = GL_UNSIGNED_INT
+	};
+};
+
 OFX_OPENGL_PRIMITIVES_END_NAMESPACE
 
 namespace ofxOpenGLPrimitives = ofx::OpenGLPrimitives;
\ No newline at end of file
@@ -0,0 +1,402 @@
+#pragma once
+
+#include "ofxOpenGLPrimitives/Program.h"
+#include "ofxOpenGLPrimitives/DrawBatch.h"
+
+OFX_OPENGL_PRIMITIVES_BEGIN_NAMESPACE
+
+#pragma mark - HiZPyramid
+
+// max-reduced mip chain of a depth texture (GL_R32F), the farthest depth of
+// every texel footprint. needs GL 4.3 compute shaders and image load/store.
+//
+//	// after the depth pre-pass, or with last frame's depth
+//	hiz.build(depth_texture, width, height);
+//	culling.setHiZ(&hiz);
+class HiZPyramid
+{
+public:
+	OFX_OPENGL_PRIMITIVES_DEFINE_REFERENCE(HiZPyramid);
+	
+	enum {
+		LOCAL_SIZE = 8
+	};
+	
+	HiZPyramid()
+		: texture(0)
+		, width(0)
+		, height(0)
+		, num_levels(0)
+	{}
+	
+	~HiZPyramid()
+	{
+		if (texture) glDeleteTextures(1, &texture);
+	}
+	
+	// `depth` is a GL_TEXTURE_2D depth texture of width x height
+	bool build(GLuint depth, GLsizei width, GLsizei height)
+	{
+		if (!program.isLinked() && !program.load(getShaderSource()))
+		{
+			ofLogError("HiZPyramid") << "can't build the reduction shader";
+			return false;
+		}
+		
+		allocate(width, height);
+		
+		program.use();
+		
+		glActiveTexture(GL_TEXTURE0);
+		glBindTexture(GL_TEXTURE_2D, depth);
+		
+		for (GLint level = 0; level < num_levels; level++)
+		{
+			const GLsizei w = getLevelWidth(level);
+			const GLsizei h = getLevelHeight(level);
+			
+			program.setUniform1i("level", level);
+			
+			if (level > 0)
+			{
+				program.setUniform2i("src_size", getLevelWidth(level - 1), getLevelHeight(level - 1));
+				glBindImageTexture(0, texture, level - 1, GL_FALSE, 0, GL_READ_ONLY, GL_R32F);
+			}
+			else
+			{
+				program.setUniform2i("src_size", w, h);
+			}
+			
+			glBindImageTexture(1, texture, level, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+			
+			program.dispatch(ComputeProgram::getNumGroups(w, LOCAL_SIZE),
+							 ComputeProgram::getNumGroups(h, LOCAL_SIZE));
+			
+			glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+		}
+		
+		glBindTexture(GL_TEXTURE_2D, 0);
+		program.release();
+		
+		glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+		
+		checkError();
+		return true;
+	}
+	
+	GLuint getTexture() const { return texture; }
+	
+	GLsizei getWidth() const { return width; }
+	GLsizei getHeight() const { return height; }
+	GLint getNumLevels() const { return num_levels; }
+	
+	GLsizei getLevelWidth(GLint level) const { return std::max(1, width >> level); }
+	GLsizei getLevelHeight(GLint level) const { return std::max(1, height >> level); }
+
+protected:
+
+	ComputeProgram program;
+	
+	GLuint texture;
+	GLsizei width, height;
+	GLint num_levels;
+	
+	void allocate(GLsizei width, GLsizei height)
+	{
+		if (texture && width == this->width && height == this->height) return;
+		
+		if (texture) glDeleteTextures(1, &texture);
+		
+		this->width = width;
+		this->height = height;
+		
+		num_levels = 1;
+		while ((std::max(width, height) >> num_levels) > 0) num_levels++;
+		
+		// immutable storage, image units can't bind incomplete textures
+		glGenTextures(1, &texture);
+		glBindTexture(GL_TEXTURE_2D, texture);
+		glTexStorage2D(GL_TEXTURE_2D, num_levels, GL_R32F, width, height);
+		
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		
+		glBindTexture(GL_TEXTURE_2D, 0);
+	}
+	
+	// level 0 copies the depth, every other level takes the max of its
+	// footprint in the level above. odd sizes fold the last row / column
+	// into the last texel so nothing is lost.
+	static const char* getShaderSource()
+	{
+		return
+		"#version 430\n"
+		"layout(local_size_x = 8, local_size_y = 8) in;\n"
+		"layout(binding = 0) uniform sampler2D depth;\n"
+		"layout(r32f, binding = 0) readonly uniform image2D src;\n"
+		"layout(r32f, binding = 1) writeonly uniform image2D dst;\n"
+		"uniform int level;\n"
+		"uniform ivec2 src_size;\n"
+		"void main() {\n"
+		"	ivec2 p = ivec2(gl_GlobalInvocationID.xy);\n"
+		"	ivec2 size = imageSize(dst);\n"
+		"	if (any(greaterThanEqual(p, size))) return;\n"
+		"	float d;\n"
+		"	if (level == 0) {\n"
+		"		d = texelFetch(depth, p, 0).r;\n"
+		"	} else {\n"
+		"		ivec2 q = p * 2;\n"
+		"		ivec2 n = ivec2(2) + ivec2(equal(p, size - 1)) * (src_size & 1);\n"
+		"		d = 0.0;\n"
+		"		for (int y = 0; y < n.y; y++)\n"
+		"			for (int x = 0; x < n.x; x++)\n"
+		"				d = max(d, imageLoad(src, min(q + ivec2(x, y), src_size - 1)).r);\n"
+		"	}\n"
+		"	imageStore(dst, p, vec4(d));\n"
+		"}\n";
+	}
+
+private:
+
+	HiZPyramid(const HiZPyramid&);
+	HiZPyramid& operator=(const HiZPyramid&);
+};
+
+#pragma mark - CullingPass
+
+// GPU-driven culling of a DrawBatch. a compute pass tests the bounding
+// sphere of every instance against the frustum and optionally a HiZPyramid,
+// then compacts the survivors per command into its own copy of the
+// indirect buffer and its own draw ids. nothing is read back, and the batch
+// itself is left untouched, so batch.draw() still draws every instance:
+//
+//	batch.upload();
+//	culling.setViewProjection(camera.getModelViewProjectionMatrix());
+//	culling.cull(batch);
+//	culling.draw(batch);
+//
+// the results belong to the last batch passed to cull(), call it again
+// after every upload() of the batch.
+//
+// the view projection is in openFrameworks order (row vectors), like the
+// matrices handed to DrawBatch::add(). depth is expected in [0, 1] as
+// written by the default glDepthRange.
+class CullingPass
+{
+public:
+	OFX_OPENGL_PRIMITIVES_DEFINE_REFERENCE(CullingPass);
+	
+	enum {
+		LOCAL_SIZE = 64
+	};
+	
+	// shader storage bindings used while the pass runs
+	enum {
+		MATRIX_BINDING = 0,
+		BOUNDS_BINDING,
+		INSTANCE_COMMAND_BINDING,
+		COMMAND_BINDING,
+		VISIBLE_BINDING
+	};
+	
+	CullingPass()
+		: command_buffer(GL_DRAW_INDIRECT_BUFFER)
+		, visible_buffer(GL_ARRAY_BUFFER)
+		, hiz(NULL)
+		, culled_batch(NULL)
+		, num_culled_commands(0)
+		, num_culled_instances(0)
+	{}
+	
+	void setViewProjection(const ofMatrix4x4& m) { view_projection = m; }
+	
+	// NULL disables the occlusion test, the pyramid must outlive cull()
+	void setHiZ(const HiZPyramid* hiz) { this->hiz = hiz; }
+	
+	void cull(DrawBatch& batch)
+	{
+		const GLuint num_instances = batch.getNumInstances();
+		const GLuint num_commands = batch.getNumCommands();
+		
+		if (num_instances == 0) return;
+		
+		if (!program.isLinked() && !program.load(getShaderSource()))
+		{
+			ofLogError("CullingPass") << "can't build the culling shader";
+			return;
+		}
+		
+		// written by the GPU only, no need to orphan
+		visible_buffer.bind();
+		visible_buffer.reserve(num_instances * sizeof(GLuint), GL_DYNAMIC_COPY);
+		visible_buffer.unbind();
+		
+		// the instance counts are rewritten in a copy of the commands
+		const GLsizeiptr command_bytes = num_commands * sizeof(DrawElementsIndirectCommand);
+		
+		command_buffer.bind();
+		command_buffer.reserve(command_bytes, GL_DYNAMIC_COPY);
+		command_buffer.unbind();
+		
+		glBindBuffer(GL_COPY_READ_BUFFER, batch.getCommandBuffer().getHandle());
+		glBindBuffer(GL_COPY_WRITE_BUFFER, command_buffer.getHandle());
+		glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, command_bytes);
+		glBindBuffer(GL_COPY_READ_BUFFER, 0);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+		
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, MATRIX_BINDING, batch.getMatrixBuffer().getHandle());
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, BOUNDS_BINDING, batch.getBoundsBuffer().getHandle());
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, INSTANCE_COMMAND_BINDING, batch.getInstanceCommandBuffer().getHandle());
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, COMMAND_BINDING, command_buffer.getHandle());
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, VISIBLE_BINDING, visible_buffer.getHandle());
+		
+		const bool use_hiz = hiz && hiz->getTexture();
+		
+		if (use_hiz)
+		{
+			glActiveTexture(GL_TEXTURE0);
+			glBindTexture(GL_TEXTURE_2D, hiz->getTexture());
+		}
+		
+		program.use();
+		
+		program.setUniform1ui("num_instances", num_instances);
+		program.setUniform1ui("num_commands", num_commands);
+		program.setUniform("view_projection", view_projection);
+		program.setUniform1i("use_hiz", use_hiz);
+		program.setUniform2f("hiz_size", use_hiz ? hiz->getWidth() : 1, use_hiz ? hiz->getHeight() : 1);
+		program.setUniform1i("hiz_max_level", use_hiz ? hiz->getNumLevels() - 1 : 0);
+		
+		// zero the instance counts, then count and compact the survivors
+		program.setUniform1i("pass", 0);
+		program.dispatch(ComputeProgram::getNumGroups(num_commands, LOCAL_SIZE));
+		
+		glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+		
+		program.setUniform1i("pass", 1);
+		program.dispatch(ComputeProgram::getNumGroups(num_instances, LOCAL_SIZE));
+		
+		program.release();
+		
+		if (use_hiz) glBindTexture(GL_TEXTURE_2D, 0);
+		
+		for (GLuint i = MATRIX_BINDING; i <= VISIBLE_BINDING; i++)
+			glBindBufferBase(GL_SHADER_STORAGE_BUFFER, i, 0);
+		
+		glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT);
+		
+		culled_batch = &batch;
+		num_culled_commands = num_commands;
+		num_culled_instances = num_instances;
+		
+		checkError();
+	}
+	
+	// draw the survivors of the last cull() of `batch`. a batch that wasn't
+	// culled last, or changed size since, is drawn without culling.
+	void draw(const DrawBatch& batch) const
+	{
+		if (culled_batch != &batch
+			|| num_culled_commands != batch.getNumCommands()
+			|| num_culled_instances != batch.getNumInstances())
+		{
+			batch.draw();
+			return;
+		}
+		
+		batch.draw(command_buffer, visible_buffer);
+	}
+	
+	// the culled commands and the instance indices compacted per command
+	Buffer& getCommandBuffer() { return command_buffer; }
+	Buffer& getVisibleBuffer() { return visible_buffer; }
+
+protected:
+
+	ComputeProgram program;
+	
+	Buffer command_buffer;
+	Buffer visible_buffer;
+	
+	ofMatrix4x4 view_projection;
+	const HiZPyramid* hiz;
+	
+	const DrawBatch* culled_batch;
+	size_t num_culled_commands;
+	size_t num_culled_instances;
+	
+	// planes come from the rows of the clip matrix (Gribb / Hartmann). the
+	// Hi-Z test projects the world space box of the sphere, picks the level
+	// where it spans at most 2x2 texels and compares its nearest depth with
+	// the farthest depth stored there. boxes crossing the near plane pass.
+	static const char* getShaderSource()
+	{
+		return
+		"#version 430\n"
+		"layout(local_size_x = 64) in;\n"
+		"struct Command { uint count; uint instance_count; uint first_index; int base_vertex; uint base_instance; };\n"
+		"layout(std430, binding = 0) readonly buffer Matrices { mat4 model_matrix[]; };\n"
+		"layout(std430, binding = 1) readonly buffer Bounds { vec4 bounds[]; };\n"
+		"layout(std430, binding = 2) readonly buffer InstanceCommands { uint instance_command[]; };\n"
+		"layout(std430, binding = 3) buffer Commands { Command commands[]; };\n"
+		"layout(std430, binding = 4) writeonly buffer Visible { uint visible[]; };\n"
+		"layout(binding = 0) uniform sampler2D hiz;\n"
+		"uniform uint num_instances;\n"
+		"uniform uint num_commands;\n"
+		"uniform mat4 view_projection;\n"
+		"uniform int use_hiz;\n"
+		"uniform vec2 hiz_size;\n"
+		"uniform int hiz_max_level;\n"
+		"uniform int pass;\n"
+		"bool occluded(vec3 c, float r) {\n"
+		"	vec3 lo = vec3(1.0), hi = vec3(-1.0);\n"
+		"	for (int i = 0; i < 8; i++) {\n"
+		"		vec3 corner = c + r * vec3((i & 1) != 0 ? 1.0 : -1.0, (i & 2) != 0 ? 1.0 : -1.0, (i & 4) != 0 ? 1.0 : -1.0);\n"
+		"		vec4 p = view_projection * vec4(corner, 1.0);\n"
+		"		if (p.w <= 0.0) return false;\n"
+		"		p.xyz /= p.w;\n"
+		"		lo = min(lo, p.xyz);\n"
+		"		hi = max(hi, p.xyz);\n"
+		"	}\n"
+		"	vec2 uv0 = clamp(lo.xy * 0.5 + 0.5, 0.0, 1.0);\n"
+		"	vec2 uv1 = clamp(hi.xy * 0.5 + 0.5, 0.0, 1.0);\n"
+		"	vec2 extent = (uv1 - uv0) * hiz_size;\n"
+		"	float level = clamp(ceil(log2(max(max(extent.x, extent.y), 1.0))), 0.0, float(hiz_max_level));\n"
+		"	float d = max(max(textureLod(hiz, uv0, level).r, textureLod(hiz, vec2(uv1.x, uv0.y), level).r),\n"
+		"				  max(textureLod(hiz, vec2(uv0.x, uv1.y), level).r, textureLod(hiz, uv1, level).r));\n"
+		"	return lo.z * 0.5 + 0.5 > d;\n"
+		"}\n"
+		"void main() {\n"
+		"	uint i = gl_GlobalInvocationID.x;\n"
+		"	if (pass == 0) {\n"
+		"		if (i < num_commands) commands[i].instance_count = 0u;\n"
+		"		return;\n"
+		"	}\n"
+		"	if (i >= num_instances) return;\n"
+		"	vec4 b = bounds[i];\n"
+		"	if (b.w >= 0.0) {\n"
+		"		mat4 m = model_matrix[i];\n"
+		"		vec3 c = (m * vec4(b.xyz, 1.0)).xyz;\n"
+		"		float r = b.w * sqrt(max(max(dot(m[0].xyz, m[0].xyz), dot(m[1].xyz, m[1].xyz)), dot(m[2].xyz, m[2].xyz)));\n"
+		"		mat4 t = transpose(view_projection);\n"
+		"		for (int k = 0; k < 6; k++) {\n"
+		"			vec4 plane = t[3] + ((k & 1) == 0 ? 1.0 : -1.0) * t[k / 2];\n"
+		"			if (dot(plane.xyz, c) + plane.w < -r * length(plane.xyz)) return;\n"
+		"		}\n"
+		"		if (use_hiz != 0 && occluded(c, r)) return;\n"
+		"	}\n"
+		"	uint cmd = instance_command[i];\n"
+		"	uint slot = atomicAdd(commands[cmd].instance_count, 1u);\n"
+		"	visible[commands[cmd].base_instance + slot] = i;\n"
+		"}\n";
+	}
+
+private:
+
+	CullingPass(const CullingPass&);
+	CullingPass& operator=(const CullingPass&);
+};
+
+OFX_OPENGL_PRIMITIVES_END_NAMESPACE
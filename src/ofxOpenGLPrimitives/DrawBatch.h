@@ -0,0 +1,232 @@
+#pragma once
+
+#include "ofxOpenGLPrimitives/GeometryArena.h"
+
+OFX_OPENGL_PRIMITIVES_BEGIN_NAMESPACE
+
+// layout of GL_DRAW_INDIRECT_BUFFER records for glMultiDrawElementsIndirect
+struct DrawElementsIndirectCommand
+{
+	GLuint count;
+	GLuint instance_count;
+	GLuint first_index;
+	GLint base_vertex;
+	GLuint base_instance;
+};
+
+#pragma mark - DrawBatch
+
+// collects draws of meshes living in one GeometryArena and submits them
+// with a single glMultiDrawElementsIndirect. model matrices go to a shader
+// storage buffer, one per instance. the instance index reaches the shader
+// through an integer attribute with divisor 1 that is offset by each
+// command's base instance, so gl_DrawID (GL 4.6) isn't needed:
+//
+//	layout(location = 15) in uint draw_id;
+//	layout(std430, binding = 0) buffer Matrices { mat4 model_matrix[]; };
+//	...
+//	gl_Position = projection * view * model_matrix[draw_id] * position;
+//
+//	batch.clear();
+//	batch.add(mesh, node.getGlobalTransformMatrix());
+//	...
+//	batch.upload();
+//	renderer.draw(batch);
+//
+// the commands copy base vertices and first indices from the arena, so a
+// batch has to be rebuilt after the arena relocated its meshes, see
+// GeometryArena::getGeneration(). draw() skips stale batches.
+//
+// an optional object space bounding sphere per add() (xyz center, w radius,
+// negative w never culls) feeds CullingPass, which writes culled copies of
+// the commands and draw ids on the GPU for draw(commands, draw_ids).
+class DrawBatch
+{
+public:
+	OFX_OPENGL_PRIMITIVES_DEFINE_REFERENCE(DrawBatch);
+	
+	DrawBatch(GeometryArena& arena, GLuint draw_id_location = 15, GLuint matrix_binding = 0)
+		: arena(arena)
+		, draw_id_location(draw_id_location)
+		, matrix_binding(matrix_binding)
+		, mode(GL_TRIANGLES)
+		, generation(arena.getGeneration())
+		, num_draw_ids(0)
+		, command_buffer(GL_DRAW_INDIRECT_BUFFER)
+		, matrix_buffer(GL_SHADER_STORAGE_BUFFER)
+		, draw_id_buffer(GL_ARRAY_BUFFER)
+		, bounds_buffer(GL_SHADER_STORAGE_BUFFER)
+		, instance_command_buffer(GL_SHADER_STORAGE_BUFFER)
+	{}
+	
+	void clear()
+	{
+		commands.clear();
+		matrices.clear();
+		bounds.clear();
+		instance_commands.clear();
+	}
+	
+	// consecutive adds of the same mesh become instances of one command
+	void add(GeometryArena::Handle mesh, const ofMatrix4x4& model, const ofVec4f& sphere = ofVec4f(0, 0, 0, -1))
+	{
+		add(mesh, &model, 1, sphere);
+	}
+	
+	void add(GeometryArena::Handle mesh, const ofMatrix4x4* models, size_t count, const ofVec4f& sphere = ofVec4f(0, 0, 0, -1))
+	{
+		if (!arena.isValid(mesh) || count == 0) return;
+		
+		const GeometryArena::Allocation& a = arena.getAllocation(mesh);
+		
+		if (commands.empty())
+		{
+			mode = a.mode;
+			generation = arena.getGeneration();
+		}
+		
+		if (a.mode != mode)
+		{
+			ofLogError("DrawBatch") << "all meshes of a batch need the same primitive mode";
+			return;
+		}
+		
+		const GLuint base_instance = matrices.size();
+		matrices.insert(matrices.end(), models, models + count);
+		bounds.insert(bounds.end(), count, sphere);
+		
+		if (!commands.empty())
+		{
+			DrawElementsIndirectCommand& last = commands.back();
+			
+			if (last.first_index == a.first_index && last.base_vertex == a.base_vertex
+				&& last.base_instance + last.instance_count == base_instance)
+			{
+				last.instance_count += count;
+				instance_commands.insert(instance_commands.end(), count, commands.size() - 1);
+				return;
+			}
+		}
+		
+		instance_commands.insert(instance_commands.end(), count, commands.size());
+		
+		DrawElementsIndirectCommand c;
+		c.count = a.num_indices;
+		c.instance_count = count;
+		c.first_index = a.first_index;
+		c.base_vertex = a.base_vertex;
+		c.base_instance = base_instance;
+		
+		commands.push_back(c);
+	}
+	
+	// write commands and matrices to the GPU, call once after the adds
+	void upload()
+	{
+		upload(command_buffer, commands.data(), commands.size() * sizeof(DrawElementsIndirectCommand));
+		upload(matrix_buffer, matrices.data(), matrices.size() * sizeof(ofMatrix4x4));
+		upload(bounds_buffer, bounds.data(), bounds.size() * sizeof(ofVec4f));
+		upload(instance_command_buffer, instance_commands.data(), instance_commands.size() * sizeof(GLuint));
+		
+		// draw ids are the identity, they only grow
+		if (num_draw_ids < matrices.size())
+		{
+			vector<GLuint> ids(matrices.size());
+			for (size_t i = 0; i < ids.size(); i++) ids[i] = i;
+			
+			upload(draw_id_buffer, ids.data(), ids.size() * sizeof(GLuint));
+			num_draw_ids = ids.size();
+		}
+	}
+	
+	void draw() const { draw(command_buffer, draw_id_buffer); }
+	
+	// draw with indirect commands and draw ids produced elsewhere, e.g. by a
+	// CullingPass. both have to be laid out like the ones of this batch.
+	void draw(const Buffer& indirect_commands, const Buffer& draw_ids) const
+	{
+		if (commands.empty() || !arena.getVertexArray()) return;
+		
+		if (isStale())
+		{
+			ofLogError("DrawBatch") << "the arena relocated its meshes since the batch was built, rebuild it";
+			return;
+		}
+		
+		arena.use();
+		
+		// the arena may have replaced its VAO, so attach the ids every time
+		glBindBuffer(GL_ARRAY_BUFFER, draw_ids.getHandle());
+		
+		glVertexAttribIPointer(draw_id_location, 1, GL_UNSIGNED_INT, 0, NULL);
+		glVertexAttribDivisor(draw_id_location, 1);
+		glEnableVertexAttribArray(draw_id_location);
+		
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, matrix_binding, matrix_buffer.getHandle());
+		
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirect_commands.getHandle());
+		glMultiDrawElementsIndirect(mode, GL_UNSIGNED_INT, NULL, commands.size(), 0);
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+		
+		arena.release();
+	}
+	
+	// lets Renderer_::draw() submit a batch, instance counts come from add()
+	void drawInstanced(GLsizei primcount) const { draw(); }
+	
+	// true once the arena moved meshes after the commands were recorded
+	bool isStale() const { return !commands.empty() && generation != arena.getGeneration(); }
+	
+	size_t getNumCommands() const { return commands.size(); }
+	size_t getNumInstances() const { return matrices.size(); }
+	
+	const vector<DrawElementsIndirectCommand>& getCommands() const { return commands; }
+	
+	GeometryArena& getArena() const { return arena; }
+	
+	Buffer& getCommandBuffer() { return command_buffer; }
+	Buffer& getMatrixBuffer() { return matrix_buffer; }
+	Buffer& getBoundsBuffer() { return bounds_buffer; }
+	Buffer& getInstanceCommandBuffer() { return instance_command_buffer; }
+
+protected:
+
+	GeometryArena& arena;
+	
+	GLuint draw_id_location;
+	GLuint matrix_binding;
+	
+	GLenum mode;
+	GLuint generation;
+	
+	vector<DrawElementsIndirectCommand> commands;
+	vector<ofMatrix4x4> matrices;
+	size_t num_draw_ids;
+	
+	// per instance
+	vector<ofVec4f> bounds;
+	vector<GLuint> instance_commands;
+	
+	// bound from draw() const
+	mutable Buffer command_buffer;
+	mutable Buffer matrix_buffer;
+	mutable Buffer draw_id_buffer;
+	
+	Buffer bounds_buffer;
+	Buffer instance_command_buffer;
+	
+	static void upload(Buffer& buffer, const GLvoid* data, GLsizeiptr num_bytes)
+	{
+		if (num_bytes == 0) return;
+		
+		buffer.bind();
+		
+		if (!buffer.reserve(num_bytes, GL_STREAM_DRAW))
+			buffer.orphan();
+		
+		buffer.setSubData(data, 0, num_bytes);
+		buffer.unbind();
+	}
+};
+
+OFX_OPENGL_PRIMITIVES_END_NAMESPACE
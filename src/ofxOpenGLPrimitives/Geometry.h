@@ -1,9 +1,19 @@
 #pragma once
 
 #include "ofxOpenGLPrimitives/VertexAttribute.h"
+#include "ofxOpenGLPrimitives/MeshOptimizer.h"
 
 OFX_OPENGL_PRIMITIVES_BEGIN_NAMESPACE
 
+namespace detail {
+
+struct NoInstancedAttribute
+{
+	static void bindFormat(VertexArray* vao) {}
+};
+
+}
+
 template <
 	typename T0 = detail::NullType0,
 	typename T1 = detail::NullType1,
@@ -11,14 +21,24 @@ template <
 	typename T3 = detail::NullType3,
 	typename T4 = detail::NullType4,
 	typename T5 = detail::NullType5,
-	typename T6 = detail::NullType6
+	typename T6 = detail::NullType6,
+	typename Layout = VertexLayout::Separate
 >
 class Geometry_
-	: public VertexAttribute_<Vertex, T0, T1, T2, T3, T4, T5, T6>
+	: public VertexAttribute_<Vertex, T0, T1, T2, T3, T4, T5, T6, Layout>
 {
-	typedef VertexAttribute_<Vertex, T0, T1, T2, T3, T4, T5, T6> VertexAttribute;
+	typedef VertexAttribute_<Vertex, T0, T1, T2, T3, T4, T5, T6, Layout> VertexAttribute;
 	
 public:
+	
+	Geometry_()
+		: mode(GL_TRIANGLES)
+		, index_type_hint(IndexType::AUTO)
+		, index_type(GL_UNSIGNED_INT)
+		, shared_vao(NULL)
+		, instanced_attribute(NULL)
+		, bind_instanced_buffers(NULL)
+	{}
 
 	void vertex(const ofVec3f& v) { Vertex::vertex(v); Geometry_::push(); }
 	void vertex(float x, float y, float z) { Vertex::vertex(x, y, z); Geometry_::push(); }
@@ -30,24 +50,184 @@ public:
 		Geometry_::reset();
 	}
 	
+	void reserve(size_t n)
+	{
+		VertexAttribute::reserve(n);
+		indices.reserve(indices.size() + n);
+	}
+	
+	// bulk version of vertex(), see VertexAttribute_::append()
+	void append(size_t count,
+				const ofVec3f* vertices,
+				const typename T0::value_type* a0 = NULL,
+				const typename T1::value_type* a1 = NULL,
+				const typename T2::value_type* a2 = NULL,
+				const typename T3::value_type* a3 = NULL,
+				const typename T4::value_type* a4 = NULL,
+				const typename T5::value_type* a5 = NULL,
+				const typename T6::value_type* a6 = NULL)
+	{
+		const GLuint first = VertexAttribute::num_vertices;
+		
+		const size_t n = indices.size();
+		indices.resize(n + count);
+		
+		GLuint* dst = indices.data() + n;
+		for (size_t i = 0; i < count; i++)
+			dst[i] = first + i;
+		
+		VertexAttribute::append(count, vertices, a0, a1, a2, a3, a4, a5, a6);
+	}
+	
+	// merge vertices whose attributes are all identical and rewrite the
+	// indices. positions are compared on a grid of `epsilon` cells, so with
+	// epsilon > 0 close vertices straddling a cell border stay apart.
+	// call before end(), or call end() again afterwards. returns the new
+	// number of vertices.
+	size_t weld(float epsilon = 0);
+	
+	// GL_TRIANGLES only. reorder triangles for the post-transform vertex
+	// cache, then by cluster to reduce overdraw, then renumber the
+	// vertices in first use order. call before end() like weld().
+	void optimize(VertexCacheStatistics* before = NULL, VertexCacheStatistics* after = NULL);
+	
+	void optimizeVertexCache();
+	void optimizeOverdraw(float threshold = 1.05);
+	void optimizeVertexFetch();
+	
+	VertexCacheStatistics analyzeVertexCache(size_t cache_size = 16) const;
+	
+	// the indices as a plain triangle list, without restart indices
+	bool getTriangleList(vector<GLuint>& triangles) const;
+	
+	// draw a sub-range of the index buffer, `first` counts indices
+	void drawRange(GLuint first, GLsizei count) const
+	{
+		bindVertexArray();
+		enablePrimitiveRestart();
+		glDrawElements(mode, count, index_type, (const GLvoid*)(first * getIndexSize()));
+		unbindVertexArray();
+	}
+	
+	void drawRangeInstanced(GLuint first, GLsizei count, GLsizei primcount) const
+	{
+		bindVertexArray();
+		enablePrimitiveRestart();
+		glDrawElementsInstanced(mode, count, index_type, (const GLvoid*)(first * getIndexSize()), primcount);
+		unbindVertexArray();
+	}
+	
+	// one glMultiDrawElements over several sub-ranges
+	void drawRanges(const GLuint* firsts, const GLsizei* counts, GLsizei num_ranges) const
+	{
+		if (num_ranges == 0) return;
+		
+		range_offsets.resize(num_ranges);
+		
+		for (GLsizei i = 0; i < num_ranges; i++)
+			range_offsets[i] = (const GLvoid*)(firsts[i] * getIndexSize());
+		
+		bindVertexArray();
+		enablePrimitiveRestart();
+		glMultiDrawElements(mode, counts, index_type, range_offsets.data(), num_ranges);
+		unbindVertexArray();
+	}
+	
+	GLenum getMode() const { return mode; }
+	size_t getIndexSize() const { return index_type == GL_UNSIGNED_SHORT ? sizeof(GLushort) : sizeof(GLuint); }
+	
+	const vector<GLuint>& getIndices() const { return indices; }
+	void setIndices(const vector<GLuint>& indices) { this->indices = indices; }
+	
+	const vector<ofVec3f>& getVertices() const { return Vertex::buffer; }
+	
+	// bounds of the vertices used by a sub-range of the index buffer, e.g.
+	// one LOD or cluster. getBounds() covers all vertices.
+	Bounds getRangeBounds(GLuint first, GLsizei count) const
+	{
+		Bounds b;
+		
+		if (first + count <= indices.size())
+			b.add(Vertex::buffer.data(), indices.data() + first, count);
+		
+		return b;
+	}
+	
 	void end() { VertexAttribute::end(); bind(); }
+	void end(StreamBuffer& stream) { VertexAttribute::end(stream); bind(); }
+	
+	// snapshot of vertices, indices and mode, see GeometryImage
+	void bake(GeometryImage& image) { VertexAttribute::bakeImage(image, mode, indices.data(), indices.size()); }
+	
+	// replaces begin() .. end() with the contents of a baked image
+	bool upload(const GeometryImage& image)
+	{
+		if (!image.isValid()) return false;
+		
+		const GeometryImage::Header& header = image.getHeader();
+		const GLuint* src = image.getIndexData();
+		
+		// the image only validates its sizes, a corrupt file can still point
+		// past the vertices
+		for (size_t i = 0; i < header.num_indices; i++)
+		{
+			if (src[i] != RESTART_INDEX && src[i] >= header.num_vertices)
+			{
+				ofLogError("Geometry_") << "image has an index out of range: " << src[i];
+				return false;
+			}
+		}
+		
+		if (!VertexAttribute::readImage(image)) return false;
+		
+		mode = header.mode;
+		indices.assign(image.getIndexData(), image.getIndexData() + header.num_indices);
+		
+		bind();
+		return true;
+	}
+	
+	bool save(const string& path)
+	{
+		GeometryImage image;
+		bake(image);
+		return image.save(path);
+	}
+	
+	bool load(const string& path)
+	{
+		GeometryImage image;
+		return image.load(path) && upload(image);
+	}
 	
 	void draw() const
 	{
-		vao->bind();
-		glDrawElements(mode, indices.size(), GL_UNSIGNED_INT, NULL);
-		vao->unbind();
+		bindVertexArray();
+		enablePrimitiveRestart();
+		glDrawElements(mode, indices.size(), index_type, NULL);
+		unbindVertexArray();
 	}
 	
 	void drawInstanced(GLsizei primcount) const
 	{
-		vao->bind();
-		glDrawElementsInstanced(mode, indices.size(), GL_UNSIGNED_INT, NULL, primcount);
-		vao->unbind();
+		bindVertexArray();
+		enablePrimitiveRestart();
+		glDrawElementsInstanced(mode, indices.size(), index_type, NULL, primcount);
+		unbindVertexArray();
 	}
 	
-	void use() const { vao->bind(); }
-	void release() const { vao->unbind(); }
+	// instanced attributes start at element `base_instance`, e.g. one range
+	// of a SceneBVH query (GL 4.2)
+	void drawInstanced(GLsizei primcount, GLuint base_instance) const
+	{
+		bindVertexArray();
+		enablePrimitiveRestart();
+		glDrawElementsInstancedBaseInstance(mode, indices.size(), index_type, NULL, primcount, base_instance);
+		unbindVertexArray();
+	}
+	
+	void use() const { bindVertexArray(); enablePrimitiveRestart(); }
+	void release() const { unbindVertexArray(); }
 
 	void restart() { indices.push_back(RESTART_INDEX); }
 	
@@ -55,49 +235,222 @@ public:
 	
 	void setUsage(GLenum usage) { this->usage = usage; }
 	
+	// IndexType::AUTO stores GL_UNSIGNED_SHORT indices when the vertex count
+	// allows it, applied at end()
+	void setIndexType(IndexType::Enum type) { index_type_hint = type; }
+	GLenum getIndexType() const { return index_type; }
+	
+	GLuint getRestartIndex() const { return index_type == GL_UNSIGNED_SHORT ? SHORT_RESTART_INDEX : RESTART_INDEX; }
+	
 	template <typename T>
 	void bindInstancedAttribute(T& v, GLuint divisor = 1)
 	{
 		v.setDivisor(divisor);
 		
-		vao->bind();
-		v.bind(vao.get());
-		vao->unbind();
+		if (shared_vao)
+		{
+			// the shared VAO of this geometry type plus the layout of T
+			shared_vao = &getSharedVertexArray<T>;
+			instanced_attribute = &v;
+			bind_instanced_buffers = &bindInstancedBuffers<T>;
+			return;
+		}
+		
+		VertexArray* own = getOwnVertexArray();
+		
+		own->bind();
+		v.bind(own);
+		own->unbind();
 	}
 	
+	// draw from one VAO shared by every Geometry_ of this type and only
+	// attach the buffers per draw (GL 4.3 or ARB_vertex_attrib_binding).
+	// needs a GL context, call before end(). only one instanced attribute
+	// can be bound in this mode. the VAOs live in SharedVertexArrays.
+	void setSharedVertexArray(bool enable)
+	{
+		if (enable && !VertexArray::isAttribBindingSupported())
+		{
+			ofLogWarning("Geometry_") << "ARB_vertex_attrib_binding isn't supported, using a VAO per geometry";
+			enable = false;
+		}
+		
+		shared_vao = enable ? &getSharedVertexArray<detail::NoInstancedAttribute> : NULL;
+		instanced_attribute = NULL;
+		bind_instanced_buffers = NULL;
+	}
+	
+	bool isSharedVertexArray() const { return shared_vao != NULL; }
+	
 protected:
 	
 	enum {
-		RESTART_INDEX = 0xFFFFFFFF
+		RESTART_INDEX = 0xFFFFFFFF,
+		SHORT_RESTART_INDEX = 0xFFFF
 	};
 	
 	GLenum mode;
 	std::vector<GLuint> indices;
+	
+	IndexType::Enum index_type_hint;
+	GLenum index_type;
+	
+	// narrowed copy of indices, only used while uploading
+	std::vector<GLushort> short_indices;
+	
+	// scratch for drawRanges()
+	mutable std::vector<const GLvoid*> range_offsets;
 
 	ofPtr<Buffer> index_buffer;
 	ofPtr<VertexArray> vao;
+	
+	// set by setSharedVertexArray(), looked up per draw since the VAO
+	// belongs to the current context
+	VertexArray& (*shared_vao)();
+	void* instanced_attribute;
+	void (*bind_instanced_buffers)(void* attribute, VertexArray* vao);
+	
+	// one per geometry type and instanced attribute type, holds only formats
+	template <typename Instanced>
+	static VertexArray& getSharedVertexArray()
+	{
+		static char layout;
+		
+		bool created = false;
+		VertexArray& shared = SharedVertexArrays::get(&layout, created);
+		
+		if (created)
+		{
+			shared.bind();
+			
+			VertexAttribute::bindFormat(&shared);
+			Instanced::bindFormat(&shared);
+			
+			shared.unbind();
+		}
+		
+		return shared;
+	}
+	
+	// the own VAO, created here if setSharedVertexArray(false) came after end()
+	VertexArray* getOwnVertexArray() const
+	{
+		if (!vao)
+		{
+			assert(index_buffer && "call end() first");
+			
+			Geometry_* self = const_cast<Geometry_*>(this);
+			self->vao = ofPtr<VertexArray>(new VertexArray);
+			
+			vao->bind();
+			self->VertexAttribute::bind(vao.get());
+			index_buffer->bind();
+		}
+		
+		return vao.get();
+	}
+	
+	template <typename Instanced>
+	static void bindInstancedBuffers(void* attribute, VertexArray* vao)
+	{
+		((Instanced*)attribute)->bindBuffers(vao);
+	}
+	
+	void bindVertexArray() const
+	{
+		if (!shared_vao)
+		{
+			getOwnVertexArray()->bind();
+			return;
+		}
+		
+		VertexArray* shared = &shared_vao();
+		shared->bind();
+		
+		Geometry_* self = const_cast<Geometry_*>(this);
+		self->VertexAttribute::bindBuffers(shared);
+		
+		if (bind_instanced_buffers) bind_instanced_buffers(instanced_attribute, shared);
+		
+		// the element buffer binding is VAO state
+		index_buffer->bind();
+	}
+	
+	void unbindVertexArray() const
+	{
+		glBindVertexArray(0);
+	}
 
+	// the VAO and the index buffer live as long as the geometry, rebuilds
+	// only re-specify the pointers that changed and reuse the storage
 	void bind()
 	{
-		vao = ofPtr<VertexArray>(new VertexArray);
-		vao->bind();
-
-		VertexAttribute::bind(vao.get());
+		if (shared_vao)
+		{
+			shared_vao().bind();
+		}
+		else
+		{
+			if (!vao) vao = ofPtr<VertexArray>(new VertexArray);
+			vao->bind();
+			
+			VertexAttribute::bind(vao.get());
+		}
 		
-		index_buffer = ofPtr<Buffer>(new Buffer(GL_ELEMENT_ARRAY_BUFFER));
+		if (!index_buffer) index_buffer = ofPtr<Buffer>(new Buffer(GL_ELEMENT_ARRAY_BUFFER));
 		index_buffer->bind();
-		index_buffer->setData(indices.data(), indices.size() * sizeof(GLuint), VertexAttribute::usage);
 		
-		vao->unbind();
+		index_type = chooseIndexType();
+		
+		const GLvoid* data = indices.data();
+		GLsizeiptr num_bytes = indices.size() * sizeof(GLuint);
+		
+		if (index_type == GL_UNSIGNED_SHORT)
+		{
+			short_indices.resize(indices.size());
+			
+			for (size_t i = 0; i < indices.size(); i++)
+			{
+				const GLuint index = indices[i];
+				short_indices[i] = index == RESTART_INDEX ? SHORT_RESTART_INDEX : index;
+			}
+			
+			data = short_indices.data();
+			num_bytes = short_indices.size() * sizeof(GLushort);
+		}
+		
+		if (!index_buffer->reserve(num_bytes, VertexAttribute::usage))
+			index_buffer->orphan();
+		
+		if (num_bytes) index_buffer->setSubData(data, 0, num_bytes);
+		short_indices.clear();
+		
+		unbindVertexArray();
 	}
 	
-	void reset()
+	GLenum chooseIndexType() const
 	{
-		indices.clear();
+		// 0xFFFF is reserved for the restart index
+		const bool fits = VertexAttribute::num_vertices < SHORT_RESTART_INDEX;
+		
+		if (index_type_hint == IndexType::UNSIGNED_INT) return GL_UNSIGNED_INT;
+		if (fits) return GL_UNSIGNED_SHORT;
+		
+		if (index_type_hint == IndexType::UNSIGNED_SHORT)
+			ofLogWarning("Geometry_") << "too many vertices for GL_UNSIGNED_SHORT indices, using GL_UNSIGNED_INT";
 		
+		return GL_UNSIGNED_INT;
+	}
+	
+	void enablePrimitiveRestart() const
+	{
 		glEnable(GL_PRIMITIVE_RESTART);
-		glPrimitiveRestartIndex(RESTART_INDEX);
-
+		glPrimitiveRestartIndex(getRestartIndex());
+	}
+	
+	void reset()
+	{
+		indices.clear();
 		restart();
 	}
 	
@@ -106,6 +459,227 @@ protected:
 		indices.push_back(VertexAttribute::num_vertices);
 		VertexAttribute::push();
 	}
+	
+	void remapIndices(const vector<GLuint>& remap)
+	{
+		for (size_t i = 0; i < indices.size(); i++)
+		{
+			if (indices[i] != RESTART_INDEX) indices[i] = remap[indices[i]];
+		}
+	}
+	
+	GLuint hashVertex(size_t index, float inv_epsilon) const
+	{
+		GLuint h = 2166136261u;
+		
+		if (inv_epsilon > 0)
+		{
+			const GLint cell[3] = {
+				(GLint)floorf(Vertex::buffer[index].x * inv_epsilon),
+				(GLint)floorf(Vertex::buffer[index].y * inv_epsilon),
+				(GLint)floorf(Vertex::buffer[index].z * inv_epsilon)
+			};
+			h = detail::hashBytes(cell, sizeof(cell), h);
+		}
+		else
+		{
+			h = Vertex::hash(index, h);
+		}
+		
+		h = T0::hash(index, h);
+		h = T1::hash(index, h);
+		h = T2::hash(index, h);
+		h = T3::hash(index, h);
+		h = T4::hash(index, h);
+		h = T5::hash(index, h);
+		h = T6::hash(index, h);
+		
+		return h;
+	}
+	
+	bool equalVertex(size_t a, size_t b, float inv_epsilon) const
+	{
+		if (inv_epsilon > 0)
+		{
+			const ofVec3f& va = Vertex::buffer[a];
+			const ofVec3f& vb = Vertex::buffer[b];
+			
+			for (int i = 0; i < 3; i++)
+			{
+				if (floorf(va[i] * inv_epsilon) != floorf(vb[i] * inv_epsilon)) return false;
+			}
+		}
+		else if (!Vertex::equal(a, b))
+		{
+			return false;
+		}
+		
+		return T0::equal(a, b)
+			&& T1::equal(a, b)
+			&& T2::equal(a, b)
+			&& T3::equal(a, b)
+			&& T4::equal(a, b)
+			&& T5::equal(a, b)
+			&& T6::equal(a, b);
+	}
 };
 
+//
+
+template <typename T0, typename T1, typename T2, typename T3, typename T4, typename T5, typename T6, typename Layout>
+inline size_t Geometry_<T0, T1, T2, T3, T4, T5, T6, Layout>::weld(float epsilon)
+{
+	const size_t n = VertexAttribute::num_vertices;
+	if (n == 0) return 0;
+	
+	const float inv_epsilon = epsilon > 0 ? 1.0 / epsilon : 0;
+	
+	// open addressing, linear probing, load factor <= 0.5
+	size_t table_size = 1;
+	while (table_size < n * 2) table_size <<= 1;
+	
+	const size_t mask = table_size - 1;
+	const GLuint empty = ~0u;
+	
+	vector<GLuint> table(table_size, empty);
+	vector<GLuint> remap(n);
+	
+	size_t num_unique = 0;
+	
+	for (size_t i = 0; i < n; i++)
+	{
+		size_t slot = hashVertex(i, inv_epsilon) & mask;
+		
+		while (true)
+		{
+			const GLuint j = table[slot];
+			
+			if (j == empty)
+			{
+				table[slot] = i;
+				remap[i] = num_unique++;
+				break;
+			}
+			
+			if (equalVertex(i, j, inv_epsilon))
+			{
+				remap[i] = remap[j];
+				break;
+			}
+			
+			slot = (slot + 1) & mask;
+		}
+	}
+	
+	if (num_unique == n) return n;
+	
+	VertexAttribute::remap(remap, num_unique);
+	remapIndices(remap);
+	
+	return num_unique;
+}
+
+template <typename T0, typename T1, typename T2, typename T3, typename T4, typename T5, typename T6, typename Layout>
+inline bool Geometry_<T0, T1, T2, T3, T4, T5, T6, Layout>::getTriangleList(vector<GLuint>& triangles) const
+{
+	triangles.clear();
+	
+	if (mode != GL_TRIANGLES)
+	{
+		ofLogError("Geometry_") << "triangle list requires GL_TRIANGLES";
+		return false;
+	}
+	
+	triangles.reserve(indices.size());
+	
+	size_t n = 0;
+	
+	for (size_t i = 0; i < indices.size(); i++)
+	{
+		// a restart drops the incomplete triangle
+		if (indices[i] == RESTART_INDEX)
+		{
+			triangles.resize(triangles.size() - n);
+			n = 0;
+			continue;
+		}
+		
+		triangles.push_back(indices[i]);
+		n = (n + 1) % 3;
+	}
+	
+	triangles.resize(triangles.size() - n);
+	
+	return true;
+}
+
+template <typename T0, typename T1, typename T2, typename T3, typename T4, typename T5, typename T6, typename Layout>
+inline VertexCacheStatistics Geometry_<T0, T1, T2, T3, T4, T5, T6, Layout>::analyzeVertexCache(size_t cache_size) const
+{
+	vector<GLuint> triangles;
+	if (!getTriangleList(triangles)) return VertexCacheStatistics();
+	
+	return MeshOptimizer::analyzeVertexCache(triangles.data(), triangles.size(), VertexAttribute::num_vertices, cache_size);
+}
+
+template <typename T0, typename T1, typename T2, typename T3, typename T4, typename T5, typename T6, typename Layout>
+inline void Geometry_<T0, T1, T2, T3, T4, T5, T6, Layout>::optimizeVertexCache()
+{
+	vector<GLuint> triangles;
+	if (!getTriangleList(triangles)) return;
+	
+	indices.resize(triangles.size());
+	MeshOptimizer::optimizeVertexCache(indices.data(), triangles.data(), triangles.size(), VertexAttribute::num_vertices);
+}
+
+template <typename T0, typename T1, typename T2, typename T3, typename T4, typename T5, typename T6, typename Layout>
+inline void Geometry_<T0, T1, T2, T3, T4, T5, T6, Layout>::optimizeOverdraw(float threshold)
+{
+	if (Vertex::buffer.empty()) return;
+	
+	vector<GLuint> triangles;
+	if (!getTriangleList(triangles)) return;
+	
+	indices.resize(triangles.size());
+	MeshOptimizer::optimizeOverdraw(indices.data(), triangles.data(), triangles.size(),
+									(const float*)Vertex::buffer.data(), sizeof(ofVec3f), VertexAttribute::num_vertices,
+									threshold);
+}
+
+template <typename T0, typename T1, typename T2, typename T3, typename T4, typename T5, typename T6, typename Layout>
+inline void Geometry_<T0, T1, T2, T3, T4, T5, T6, Layout>::optimizeVertexFetch()
+{
+	vector<GLuint> triangles;
+	if (!getTriangleList(triangles)) return;
+	
+	vector<GLuint> remap;
+	const size_t num_used = MeshOptimizer::optimizeVertexFetchRemap(remap, triangles.data(), triangles.size(), VertexAttribute::num_vertices);
+	
+	indices.swap(triangles);
+	
+	VertexAttribute::remap(remap, num_used);
+	remapIndices(remap);
+}
+
+template <typename T0, typename T1, typename T2, typename T3, typename T4, typename T5, typename T6, typename Layout>
+inline void Geometry_<T0, T1, T2, T3, T4, T5, T6, Layout>::optimize(VertexCacheStatistics* before, VertexCacheStatistics* after)
+{
+	if (mode != GL_TRIANGLES)
+	{
+		ofLogError("Geometry_") << "optimize() requires GL_TRIANGLES";
+		return;
+	}
+	
+	if (before) *before = analyzeVertexCache();
+	
+	if (VertexAttribute::num_vertices > 0)
+	{
+		optimizeVertexCache();
+		optimizeOverdraw();
+		optimizeVertexFetch();
+	}
+	
+	if (after) *after = analyzeVertexCache();
+}
+
 OFX_OPENGL_PRIMITIVES_END_NAMESPACE
\ No newline at end of file
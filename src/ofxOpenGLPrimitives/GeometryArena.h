@@ -0,0 +1,528 @@
+#pragma once
+
+#include "ofxOpenGLPrimitives/Object.h"
+#include "ofxOpenGLPrimitives/VertexArray.h"
+#include "ofxOpenGLPrimitives/GeometryImage.h"
+
+OFX_OPENGL_PRIMITIVES_BEGIN_NAMESPACE
+
+#pragma mark - RangeAllocator
+
+// first fit free list over [0, capacity), neighbouring free ranges are
+// merged on free()
+class RangeAllocator
+{
+public:
+
+	enum {
+		INVALID = 0xFFFFFFFF
+	};
+	
+	RangeAllocator(GLuint capacity = 0) { reset(capacity); }
+	
+	void reset(GLuint capacity)
+	{
+		this->capacity = capacity;
+		free_ranges.clear();
+		
+		if (capacity) free_ranges.push_back(Range(0, capacity));
+	}
+	
+	GLuint allocate(GLuint size)
+	{
+		if (size == 0) return 0;
+		
+		for (size_t i = 0; i < free_ranges.size(); i++)
+		{
+			Range& r = free_ranges[i];
+			if (r.second < size) continue;
+			
+			const GLuint offset = r.first;
+			
+			r.first += size;
+			r.second -= size;
+			
+			if (r.second == 0) free_ranges.erase(free_ranges.begin() + i);
+			
+			return offset;
+		}
+		
+		return INVALID;
+	}
+	
+	void free(GLuint offset, GLuint size)
+	{
+		if (size == 0) return;
+		
+		vector<Range>::iterator it = std::lower_bound(free_ranges.begin(), free_ranges.end(), Range(offset, 0));
+		it = free_ranges.insert(it, Range(offset, size));
+		
+		// merge with the next range, then with the previous one
+		if (it + 1 != free_ranges.end() && it->first + it->second == (it + 1)->first)
+		{
+			it->second += (it + 1)->second;
+			free_ranges.erase(it + 1);
+		}
+		
+		if (it != free_ranges.begin() && (it - 1)->first + (it - 1)->second == it->first)
+		{
+			(it - 1)->second += it->second;
+			free_ranges.erase(it);
+		}
+	}
+	
+	// extend the managed space to `capacity`
+	void grow(GLuint capacity)
+	{
+		if (capacity <= this->capacity) return;
+		
+		const GLuint old_capacity = this->capacity;
+		this->capacity = capacity;
+		
+		free(old_capacity, capacity - old_capacity);
+	}
+	
+	GLuint getCapacity() const { return capacity; }
+	
+	GLuint getNumFree() const
+	{
+		GLuint n = 0;
+		for (size_t i = 0; i < free_ranges.size(); i++) n += free_ranges[i].second;
+		return n;
+	}
+	
+	size_t getNumFreeRanges() const { return free_ranges.size(); }
+
+private:
+
+	// (offset, size), sorted by offset
+	typedef std::pair<GLuint, GLuint> Range;
+	
+	GLuint capacity;
+	vector<Range> free_ranges;
+};
+
+#pragma mark - GeometryArena
+
+// packs many meshes of one vertex layout into a single vertex buffer and
+// a single GLuint index buffer, so they can share a VAO and be drawn with
+// glDrawElementsBaseVertex or batched into multi-draws. meshes come in as
+// GeometryImage, e.g. from Geometry_::bake(). the layout is taken from
+// the first image.
+//
+// with the separate layout every attribute gets its own stream of
+// `vertex_capacity` elements, so a mesh at base vertex b keeps its
+// attribute i at stream_i + b * sizeof(element).
+//
+//	GeometryArena arena;
+//	GeometryArena::Handle h = arena.add(geom);
+//	arena.use();
+//	arena.draw(h);
+//	arena.release();
+//
+// handles survive defragment() and growth, but both move the meshes, so
+// base vertices and first indices copied elsewhere (e.g. into a DrawBatch)
+// go stale. getGeneration() changes whenever that happens.
+class GeometryArena
+{
+public:
+	OFX_OPENGL_PRIMITIVES_DEFINE_REFERENCE(GeometryArena);
+	
+	typedef GLuint Handle;
+	
+	enum {
+		INVALID_HANDLE = 0xFFFFFFFF,
+		RESTART_INDEX = 0xFFFFFFFF
+	};
+	
+	struct Allocation
+	{
+		GLenum mode;
+		
+		GLint base_vertex;
+		GLuint num_vertices;
+		
+		GLuint first_index;
+		GLsizei num_indices;
+		
+		bool live;
+	};
+	
+	GeometryArena(GLuint vertex_capacity = 65536, GLuint index_capacity = 3 * 65536, GLenum usage = GL_STATIC_DRAW)
+		: usage(usage)
+		, interleaved(false)
+		, stride(0)
+		, vertex_allocator(vertex_capacity)
+		, index_allocator(index_capacity)
+		, generation(0)
+	{}
+	
+	template <typename Geometry>
+	Handle add(Geometry& geometry)
+	{
+		GeometryImage image;
+		geometry.bake(image);
+		return upload(image);
+	}
+	
+	// add a baked mesh, see UploadQueue for baking on worker threads
+	Handle upload(const GeometryImage& image);
+	void remove(Handle handle);
+	
+	// move every mesh to the front of the buffers, handles stay valid but
+	// their allocations change
+	void defragment() { relocate(vertex_allocator.getCapacity(), index_allocator.getCapacity()); }
+	
+	void use() const
+	{
+		if (!vao) return;
+		
+		vao->bind();
+		glEnable(GL_PRIMITIVE_RESTART);
+		glPrimitiveRestartIndex(RESTART_INDEX);
+	}
+	
+	void release() const { glBindVertexArray(0); }
+	
+	// between use() and release(), invalid or removed handles draw nothing
+	void draw(Handle handle) const
+	{
+		if (!isValid(handle)) return;
+		
+		const Allocation& a = allocations[handle];
+		
+		glDrawElementsBaseVertex(a.mode, a.num_indices, GL_UNSIGNED_INT,
+								 (const GLvoid*)(a.first_index * sizeof(GLuint)), a.base_vertex);
+	}
+	
+	void drawInstanced(Handle handle, GLsizei primcount) const
+	{
+		if (!isValid(handle)) return;
+		
+		const Allocation& a = allocations[handle];
+		
+		glDrawElementsInstancedBaseVertex(a.mode, a.num_indices, GL_UNSIGNED_INT,
+										  (const GLvoid*)(a.first_index * sizeof(GLuint)), primcount, a.base_vertex);
+	}
+	
+	const Allocation& getAllocation(Handle handle) const
+	{
+		assert(isValid(handle));
+		return allocations[handle];
+	}
+	
+	bool isValid(Handle handle) const { return handle < allocations.size() && allocations[handle].live; }
+	
+	// bumped by every relocation of the meshes
+	GLuint getGeneration() const { return generation; }
+	
+	size_t getNumMeshes() const { return allocations.size() - free_handles.size(); }
+	
+	GLuint getVertexCapacity() const { return vertex_allocator.getCapacity(); }
+	GLuint getIndexCapacity() const { return index_allocator.getCapacity(); }
+	
+	GLuint getNumFreeVertices() const { return vertex_allocator.getNumFree(); }
+	GLuint getNumFreeIndices() const { return index_allocator.getNumFree(); }
+	
+	// 0 when packed, approaching 1 when the free space is scattered
+	float getFragmentation() const
+	{
+		const size_t n = vertex_allocator.getNumFreeRanges() + index_allocator.getNumFreeRanges();
+		return n > 2 ? 1.0f - 2.0f / n : 0.0f;
+	}
+	
+	VertexArray* getVertexArray() const { return vao.get(); }
+	Buffer* getVertexBuffer() const { return vertex_buffer.get(); }
+	Buffer* getIndexBuffer() const { return index_buffer.get(); }
+	
+	const vector<GeometryImage::Attribute>& getAttributes() const { return attributes; }
+
+protected:
+
+	GLenum usage;
+	
+	// layout of the first image, offsets relative to a record or a stream
+	bool interleaved;
+	GLuint stride;
+	vector<GeometryImage::Attribute> attributes;
+	
+	RangeAllocator vertex_allocator;
+	RangeAllocator index_allocator;
+	
+	vector<Allocation> allocations;
+	vector<Handle> free_handles;
+	
+	GLuint generation;
+	
+	ofPtr<Buffer> vertex_buffer;
+	ofPtr<Buffer> index_buffer;
+	ofPtr<VertexArray> vao;
+	
+	bool setLayout(const GeometryImage& image);
+	bool matchLayout(const GeometryImage& image) const;
+	
+	// start of attribute i for vertex `base` with `capacity` vertices
+	GLintptr getVertexOffset(size_t i, GLuint base, GLuint capacity) const
+	{
+		if (interleaved) return (GLintptr)base * stride;
+		
+		GLintptr offset = 0;
+		
+		for (size_t k = 0; k < i; k++)
+			offset += (GLintptr)attributes[k].element_size * capacity;
+		
+		return offset + (GLintptr)base * attributes[i].element_size;
+	}
+	
+	void createBuffers();
+	
+	// copy every mesh into new buffers of the given capacity, packed
+	void relocate(GLuint vertex_capacity, GLuint index_capacity);
+	void bindAttributes();
+};
+
+inline bool GeometryArena::setLayout(const GeometryImage& image)
+{
+	const GeometryImage::Header& header = image.getHeader();
+	
+	interleaved = header.interleaved;
+	stride = header.stride;
+	attributes.assign(image.getAttributes(), image.getAttributes() + header.num_attributes);
+	
+	// stream offsets depend on the capacity, they are recomputed on bind
+	if (!interleaved)
+	{
+		for (size_t i = 0; i < attributes.size(); i++)
+			attributes[i].offset = 0;
+	}
+	
+	createBuffers();
+	return true;
+}
+
+inline bool GeometryArena::matchLayout(const GeometryImage& image) const
+{
+	const GeometryImage::Header& header = image.getHeader();
+	
+	if ((bool)header.interleaved != interleaved
+		|| header.stride != stride
+		|| header.num_attributes != attributes.size()) return false;
+	
+	for (size_t i = 0; i < attributes.size(); i++)
+	{
+		GeometryImage::Attribute a = image.getAttributes()[i];
+		if (!interleaved) a.offset = 0;
+		
+		if (!(a == attributes[i])) return false;
+	}
+	
+	return true;
+}
+
+inline void GeometryArena::createBuffers()
+{
+	vertex_buffer = ofPtr<Buffer>(new Buffer(GL_ARRAY_BUFFER));
+	vertex_buffer->bind();
+	vertex_buffer->allocate((GLsizeiptr)stride * vertex_allocator.getCapacity(), usage);
+	vertex_buffer->unbind();
+	
+	index_buffer = ofPtr<Buffer>(new Buffer(GL_ELEMENT_ARRAY_BUFFER));
+	index_buffer->bind();
+	index_buffer->allocate((GLsizeiptr)sizeof(GLuint) * index_allocator.getCapacity(), usage);
+	index_buffer->unbind();
+	
+	bindAttributes();
+}
+
+inline void GeometryArena::bindAttributes()
+{
+	vao = ofPtr<VertexArray>(new VertexArray);
+	vao->bind();
+	
+	const GLuint capacity = vertex_allocator.getCapacity();
+	
+	for (size_t i = 0; i < attributes.size(); i++)
+	{
+		const GeometryImage::Attribute& a = attributes[i];
+		VertexArrayBinding& binding = vao->getBindings(a.location);
+		
+		binding.setFormat(a.type, a.num_components, a.normalize);
+		
+		if (interleaved) binding.setBuffer(vertex_buffer.get(), a.offset, stride);
+		else binding.setBuffer(vertex_buffer.get(), getVertexOffset(i, 0, capacity), a.element_size);
+		
+		binding.setDivisor(0);
+		binding.enable(a.location);
+	}
+	
+	index_buffer->bind();
+	vao->unbind();
+}
+
+inline GeometryArena::Handle GeometryArena::upload(const GeometryImage& image)
+{
+	if (!image.isValid()) return INVALID_HANDLE;
+	
+	const GeometryImage::Header& header = image.getHeader();
+	
+	if (!vertex_buffer) setLayout(image);
+	
+	if (!matchLayout(image))
+	{
+		ofLogError("GeometryArena") << "image has a different vertex layout";
+		return INVALID_HANDLE;
+	}
+	
+	GLuint base = vertex_allocator.allocate(header.num_vertices);
+	GLuint first = index_allocator.allocate(header.num_indices);
+	
+	if (base == RangeAllocator::INVALID || first == RangeAllocator::INVALID)
+	{
+		if (base != RangeAllocator::INVALID) vertex_allocator.free(base, header.num_vertices);
+		if (first != RangeAllocator::INVALID) index_allocator.free(first, header.num_indices);
+		
+		// grow geometrically and pack on the way
+		const GLuint vertex_capacity = std::max(vertex_allocator.getCapacity() * 2,
+												vertex_allocator.getCapacity() + header.num_vertices);
+		const GLuint index_capacity = std::max(index_allocator.getCapacity() * 2,
+											   index_allocator.getCapacity() + header.num_indices);
+		
+		relocate(vertex_capacity, index_capacity);
+		
+		base = vertex_allocator.allocate(header.num_vertices);
+		first = index_allocator.allocate(header.num_indices);
+	}
+	
+	Allocation a;
+	a.mode = header.mode;
+	a.base_vertex = base;
+	a.num_vertices = header.num_vertices;
+	a.first_index = first;
+	a.num_indices = header.num_indices;
+	a.live = true;
+	
+	// upload the streams of the image into the streams of the arena
+	vertex_buffer->bind();
+	
+	if (interleaved)
+	{
+		if (header.vertex_size)
+			vertex_buffer->setSubData(image.getVertexData(), getVertexOffset(0, base, 0), header.vertex_size);
+	}
+	else
+	{
+		const GLuint capacity = vertex_allocator.getCapacity();
+		
+		for (size_t i = 0; i < attributes.size(); i++)
+		{
+			const GeometryImage::Attribute& src = image.getAttributes()[i];
+			const GLsizei num_bytes = src.element_size * header.num_vertices;
+			
+			if (num_bytes)
+				vertex_buffer->setSubData(image.getVertexData() + src.offset, getVertexOffset(i, base, capacity), num_bytes);
+		}
+	}
+	
+	vertex_buffer->unbind();
+	
+	if (header.num_indices)
+	{
+		index_buffer->bind();
+		index_buffer->setSubData(image.getIndexData(), first * sizeof(GLuint), header.index_size);
+		index_buffer->unbind();
+	}
+	
+	Handle handle;
+	
+	if (free_handles.empty())
+	{
+		handle = allocations.size();
+		allocations.push_back(a);
+	}
+	else
+	{
+		handle = free_handles.back();
+		free_handles.pop_back();
+		allocations[handle] = a;
+	}
+	
+	return handle;
+}
+
+inline void GeometryArena::remove(Handle handle)
+{
+	if (!isValid(handle)) return;
+	
+	Allocation& a = allocations[handle];
+	
+	vertex_allocator.free(a.base_vertex, a.num_vertices);
+	index_allocator.free(a.first_index, a.num_indices);
+	
+	a.live = false;
+	free_handles.push_back(handle);
+}
+
+inline void GeometryArena::relocate(GLuint vertex_capacity, GLuint index_capacity)
+{
+	if (!vertex_buffer) return;
+	
+	ofPtr<Buffer> old_vertices = vertex_buffer;
+	ofPtr<Buffer> old_indices = index_buffer;
+	const GLuint old_capacity = vertex_allocator.getCapacity();
+	
+	vertex_allocator.reset(vertex_capacity);
+	index_allocator.reset(index_capacity);
+	
+	createBuffers();
+	
+	glBindBuffer(GL_COPY_READ_BUFFER, old_vertices->getHandle());
+	glBindBuffer(GL_COPY_WRITE_BUFFER, vertex_buffer->getHandle());
+	
+	vector<Allocation> moved(allocations);
+	
+	for (size_t h = 0; h < allocations.size(); h++)
+	{
+		const Allocation& a = allocations[h];
+		if (!a.live) continue;
+		
+		// allocating in handle order packs everything to the front
+		Allocation& b = moved[h];
+		b.base_vertex = vertex_allocator.allocate(a.num_vertices);
+		b.first_index = index_allocator.allocate(a.num_indices);
+		
+		const size_t n = interleaved ? 1 : attributes.size();
+		
+		for (size_t i = 0; i < n && a.num_vertices; i++)
+		{
+			const GLsizeiptr num_bytes = (GLsizeiptr)(interleaved ? stride : attributes[i].element_size) * a.num_vertices;
+			
+			glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER,
+								getVertexOffset(i, a.base_vertex, old_capacity),
+								getVertexOffset(i, b.base_vertex, vertex_capacity),
+								num_bytes);
+		}
+	}
+	
+	glBindBuffer(GL_COPY_READ_BUFFER, old_indices->getHandle());
+	glBindBuffer(GL_COPY_WRITE_BUFFER, index_buffer->getHandle());
+	
+	for (size_t h = 0; h < allocations.size(); h++)
+	{
+		const Allocation& a = allocations[h];
+		if (!a.live || a.num_indices == 0) continue;
+		
+		// indices are relative to the base vertex, they move as they are
+		glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER,
+							a.first_index * sizeof(GLuint),
+							moved[h].first_index * sizeof(GLuint),
+							a.num_indices * sizeof(GLuint));
+	}
+	
+	glBindBuffer(GL_COPY_READ_BUFFER, 0);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	
+	allocations.swap(moved);
+	generation++;
+}
+
+OFX_OPENGL_PRIMITIVES_END_NAMESPACE
@@ -0,0 +1,251 @@
+#pragma once
+
+#include "ofMain.h"
+
+#include "ofxOpenGLPrimitives/Constants.h"
+
+#ifndef TARGET_WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+OFX_OPENGL_PRIMITIVES_BEGIN_NAMESPACE
+
+#pragma mark - GeometryImage
+
+// the built state of a VertexAttribute_ / Geometry_ as one flat blob:
+//
+//	Header
+//	Attribute[num_attributes]
+//	vertex data, aligned to ALIGNMENT, exactly what end() uploads
+//	GLuint indices, aligned to ALIGNMENT
+//
+// the blob is in native byte order. load() maps the file, so the vertex
+// data can be handed to glBufferSubData without touching it.
+class GeometryImage
+{
+public:
+
+	enum {
+		VERSION = 1,
+		ALIGNMENT = 16
+	};
+	
+	struct Header
+	{
+		char magic[4];
+		GLuint version;
+		
+		GLuint interleaved;
+		GLuint num_attributes;
+		GLuint num_vertices;
+		GLuint stride;
+		
+		GLuint mode;
+		GLuint num_indices;
+		
+		GLuint vertex_offset, vertex_size;
+		GLuint index_offset, index_size;
+	};
+	
+	// one per Attribute_, `offset` is the start of its block in the vertex
+	// data, or its offset in the record when interleaved
+	struct Attribute
+	{
+		GLint location;
+		GLenum type;
+		GLint num_components;
+		GLuint normalize;
+		GLuint element_size;
+		GLuint offset;
+		
+		bool operator==(const Attribute& a) const
+		{
+			return location == a.location
+				&& type == a.type
+				&& num_components == a.num_components
+				&& normalize == a.normalize
+				&& element_size == a.element_size
+				&& offset == a.offset;
+		}
+	};
+	
+	GeometryImage()
+		: data(NULL)
+		, num_bytes(0)
+		, mapping(NULL)
+	{}
+	
+	~GeometryImage() { clear(); }
+	
+	// build an image in memory
+	void assign(bool interleaved, GLuint stride, const vector<Attribute>& attributes,
+				GLuint num_vertices, const GLubyte* vertices, GLuint vertex_size,
+				GLenum mode, const GLuint* indices, GLuint num_indices)
+	{
+		clear();
+		
+		Header header;
+		memcpy(header.magic, "OGPG", 4);
+		header.version = VERSION;
+		
+		header.interleaved = interleaved;
+		header.num_attributes = attributes.size();
+		header.num_vertices = num_vertices;
+		header.stride = stride;
+		
+		header.mode = mode;
+		header.num_indices = num_indices;
+		
+		header.vertex_offset = align(sizeof(Header) + attributes.size() * sizeof(Attribute));
+		header.vertex_size = vertex_size;
+		
+		header.index_offset = align(header.vertex_offset + vertex_size);
+		header.index_size = num_indices * sizeof(GLuint);
+		
+		bytes.assign(header.index_offset + header.index_size, 0);
+		
+		memcpy(&bytes[0], &header, sizeof(Header));
+		if (!attributes.empty()) memcpy(&bytes[sizeof(Header)], attributes.data(), attributes.size() * sizeof(Attribute));
+		if (vertex_size) memcpy(&bytes[header.vertex_offset], vertices, vertex_size);
+		if (num_indices) memcpy(&bytes[header.index_offset], indices, header.index_size);
+		
+		data = bytes.data();
+		num_bytes = bytes.size();
+	}
+	
+	bool save(const string& path) const
+	{
+		if (!isValid()) return false;
+		
+		FILE* fp = fopen(ofToDataPath(path).c_str(), "wb");
+		
+		if (!fp)
+		{
+			ofLogError("GeometryImage") << "can't open " << path;
+			return false;
+		}
+		
+		const bool ok = fwrite(data, 1, num_bytes, fp) == num_bytes;
+		fclose(fp);
+		
+		if (!ok) ofLogError("GeometryImage") << "write failed: " << path;
+		return ok;
+	}
+	
+	bool load(const string& path)
+	{
+		clear();
+		
+		const string file = ofToDataPath(path);
+
+#ifndef TARGET_WIN32
+		int fd = open(file.c_str(), O_RDONLY);
+		
+		if (fd < 0)
+		{
+			ofLogError("GeometryImage") << "can't open " << path;
+			return false;
+		}
+		
+		struct stat st;
+		
+		if (fstat(fd, &st) == 0 && st.st_size > 0)
+		{
+			void* p = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+			
+			if (p != MAP_FAILED)
+			{
+				mapping = p;
+				data = (const GLubyte*)p;
+				num_bytes = st.st_size;
+			}
+		}
+		
+		close(fd);
+#else
+		FILE* fp = fopen(file.c_str(), "rb");
+		
+		if (!fp)
+		{
+			ofLogError("GeometryImage") << "can't open " << path;
+			return false;
+		}
+		
+		fseek(fp, 0, SEEK_END);
+		bytes.resize(ftell(fp));
+		fseek(fp, 0, SEEK_SET);
+		
+		if (!bytes.empty() && fread(&bytes[0], 1, bytes.size(), fp) == bytes.size())
+		{
+			data = bytes.data();
+			num_bytes = bytes.size();
+		}
+		
+		fclose(fp);
+#endif
+
+		if (!isValid())
+		{
+			ofLogError("GeometryImage") << "not a geometry image or unsupported version: " << path;
+			clear();
+			return false;
+		}
+		
+		return true;
+	}
+	
+	void clear()
+	{
+#ifndef TARGET_WIN32
+		if (mapping) munmap(mapping, num_bytes);
+#endif
+		mapping = NULL;
+		
+		bytes.clear();
+		data = NULL;
+		num_bytes = 0;
+	}
+	
+	bool isValid() const
+	{
+		if (num_bytes < sizeof(Header)) return false;
+		
+		const Header& h = getHeader();
+		
+		return memcmp(h.magic, "OGPG", 4) == 0
+			&& h.version == VERSION
+			&& sizeof(Header) + h.num_attributes * sizeof(Attribute) <= h.vertex_offset
+			&& (size_t)h.vertex_offset + h.vertex_size <= h.index_offset
+			&& (size_t)h.index_offset + h.index_size <= num_bytes
+			&& h.index_size == h.num_indices * sizeof(GLuint);
+	}
+	
+	const Header& getHeader() const { return *(const Header*)data; }
+	const Attribute* getAttributes() const { return (const Attribute*)(data + sizeof(Header)); }
+	
+	const GLubyte* getVertexData() const { return data + getHeader().vertex_offset; }
+	const GLuint* getIndexData() const { return (const GLuint*)(data + getHeader().index_offset); }
+	
+	const GLubyte* getData() const { return data; }
+	size_t getNumBytes() const { return num_bytes; }
+	
+	static GLuint align(GLuint n) { return (n + ALIGNMENT - 1) & ~(GLuint)(ALIGNMENT - 1); }
+
+private:
+
+	// owned storage, empty when mapped
+	vector<GLubyte> bytes;
+	
+	const GLubyte* data;
+	size_t num_bytes;
+	
+	void* mapping;
+	
+	GeometryImage(const GeometryImage&);
+	GeometryImage& operator=(const GeometryImage&);
+};
+
+OFX_OPENGL_PRIMITIVES_END_NAMESPACE
@@ -0,0 +1,162 @@
+#pragma once
+
+#include "ofxOpenGLPrimitives/Geometry.h"
+#include "ofxOpenGLPrimitives/MeshOptimizer.h"
+
+OFX_OPENGL_PRIMITIVES_BEGIN_NAMESPACE
+
+#pragma mark - LODGeometry
+
+// a chain of simplified index lists over the vertex buffer of one
+// Geometry_. level 0 is the original mesh, every further level keeps
+// `ratio` of its triangles. all levels are appended to the index buffer
+// of the geometry, so use drawLOD() instead of Geometry_::draw().
+//
+//	geom.begin(GL_TRIANGLES);
+//	...
+//	float ratios[] = { 0.5, 0.25, 0.1 };
+//	lods.build(geom, ratios, 3);
+//	geom.end();
+//
+//	float scale = LODGeometry<Geom>::getProjectionScale(60, ofGetHeight());
+//	lods.drawLOD(lods.selectLOD(distance, scale));
+template <typename Geometry>
+class LODGeometry
+{
+public:
+	OFX_OPENGL_PRIMITIVES_DEFINE_REFERENCE(LODGeometry);
+	
+	LODGeometry() : geometry(NULL) {}
+	
+	// call between the last vertex() and end()
+	bool build(Geometry& geometry, const float* ratios, size_t num_ratios);
+	
+	size_t getNumLevels() const { return first_index.size(); }
+	
+	GLuint getFirstIndex(size_t level) const { return first_index[level]; }
+	GLsizei getNumIndices(size_t level) const { return num_indices[level]; }
+	
+	// geometric error of a level in object space units
+	float getError(size_t level) const { return error[level]; }
+	
+	// simplification keeps the vertices but may drop the extremes
+	const Bounds& getBounds(size_t level) const { return bounds[level]; }
+	
+	// pixels per object space unit at distance 1
+	static float getProjectionScale(float fov_y, float viewport_height)
+	{
+		return viewport_height / (2 * tanf(ofDegToRad(fov_y) * 0.5f));
+	}
+	
+	// the coarsest level whose projected error stays under `max_pixel_error`
+	size_t selectLOD(float distance, float projection_scale, float max_pixel_error = 1) const;
+	
+	void drawLOD(size_t level) const;
+	void drawLODInstanced(size_t level, GLsizei primcount) const;
+
+protected:
+
+	Geometry* geometry;
+	
+	vector<GLuint> first_index;
+	vector<GLsizei> num_indices;
+	vector<float> error;
+	vector<Bounds> bounds;
+};
+
+template <typename Geometry>
+inline bool LODGeometry<Geometry>::build(Geometry& geometry, const float* ratios, size_t num_ratios)
+{
+	this->geometry = &geometry;
+	
+	first_index.clear();
+	num_indices.clear();
+	error.clear();
+	bounds.clear();
+	
+	vector<GLuint> triangles;
+	if (!geometry.getTriangleList(triangles))
+	{
+		ofLogError("LODGeometry") << "build() needs GL_TRIANGLES";
+		return false;
+	}
+	
+	const vector<ofVec3f>& vertices = geometry.getVertices();
+	if (vertices.empty()) return true;
+	
+	const size_t num_triangles = triangles.size() / 3;
+	
+	vector<GLuint> indices(triangles);
+	vector<GLuint> lod(triangles.size());
+	vector<GLuint> optimized(triangles.size());
+	
+	first_index.push_back(0);
+	num_indices.push_back(triangles.size());
+	error.push_back(0);
+	bounds.push_back(Bounds());
+	bounds.back().add(vertices.data(), triangles.data(), triangles.size());
+	
+	for (size_t i = 0; i < num_ratios; i++)
+	{
+		const size_t target = (size_t)(num_triangles * ratios[i]) * 3;
+		
+		// always from the full mesh, so errors don't accumulate
+		float lod_error = 0;
+		const size_t count = MeshOptimizer::simplify(lod.data(), triangles.data(), triangles.size(),
+													 vertices[0].getPtr(), sizeof(ofVec3f), vertices.size(),
+													 target, &lod_error);
+		
+		MeshOptimizer::optimizeVertexCache(optimized.data(), lod.data(), count, vertices.size());
+		
+		first_index.push_back(indices.size());
+		num_indices.push_back(count);
+		error.push_back(std::max(lod_error, error.back()));
+		
+		bounds.push_back(Bounds());
+		bounds.back().add(vertices.data(), optimized.data(), count);
+		
+		indices.insert(indices.end(), optimized.begin(), optimized.begin() + count);
+	}
+	
+	geometry.setIndices(indices);
+	
+	return true;
+}
+
+template <typename Geometry>
+inline size_t LODGeometry<Geometry>::selectLOD(float distance, float projection_scale, float max_pixel_error) const
+{
+	if (first_index.empty()) return 0;
+	
+	distance = std::max(distance, 1e-6f);
+	
+	size_t level = 0;
+	
+	for (size_t i = 1; i < error.size(); i++)
+	{
+		if (error[i] * projection_scale / distance > max_pixel_error) break;
+		level = i;
+	}
+	
+	return level;
+}
+
+template <typename Geometry>
+inline void LODGeometry<Geometry>::drawLOD(size_t level) const
+{
+	if (!geometry || first_index.empty()) return;
+	
+	level = std::min(level, first_index.size() - 1);
+	geometry->drawRange(first_index[level], num_indices[level]);
+}
+
+template <typename Geometry>
+inline void LODGeometry<Geometry>::drawLODInstanced(size_t level, GLsizei primcount) const
+{
+	if (!geometry || first_index.empty()) return;
+	
+	level = std::min(level, first_index.size() - 1);
+	geometry->drawRangeInstanced(first_index[level], num_indices[level], primcount);
+}
+
+OFX_OPENGL_PRIMITIVES_END_NAMESPACE
@@ -0,0 +1,884 @@
+#pragma once
+
+#include "ofMain.h"
+#include <cfloat>
+
+#include "ofxOpenGLPrimitives/Constants.h"
+
+OFX_OPENGL_PRIMITIVES_BEGIN_NAMESPACE
+
+// index buffer passes over plain triangle lists (3 indices per triangle,
+// no restart indices). Geometry_ wraps them for its own data.
+
+struct VertexCacheStatistics
+{
+	size_t num_triangles;
+	size_t num_vertices_transformed;
+	
+	float acmr; // transformed vertices / triangle, 0.5 at best
+	float atvr; // transformed vertices / referenced vertex, 1.0 at best
+	
+	VertexCacheStatistics()
+		: num_triangles(0)
+		, num_vertices_transformed(0)
+		, acmr(0)
+		, atvr(0)
+	{}
+};
+
+namespace MeshOptimizer {
+
+// FIFO post-transform cache simulation
+inline VertexCacheStatistics analyzeVertexCache(const GLuint* indices, size_t num_indices, size_t num_vertices, size_t cache_size = 16)
+{
+	VertexCacheStatistics stats;
+	
+	vector<size_t> timestamps(num_vertices, 0);
+	vector<bool> referenced(num_vertices, false);
+	
+	size_t num_referenced = 0;
+	size_t time = cache_size + 1;
+	
+	for (size_t i = 0; i < num_indices; i++)
+	{
+		const GLuint v = indices[i];
+		
+		if (!referenced[v])
+		{
+			referenced[v] = true;
+			num_referenced++;
+		}
+		
+		if (time - timestamps[v] > cache_size)
+		{
+			timestamps[v] = time++;
+			stats.num_vertices_transformed++;
+		}
+	}
+	
+	stats.num_triangles = num_indices / 3;
+	
+	if (stats.num_triangles) stats.acmr = (float)stats.num_vertices_transformed / stats.num_triangles;
+	if (num_referenced) stats.atvr = (float)stats.num_vertices_transformed / num_referenced;
+	
+	return stats;
+}
+
+namespace detail {
+
+enum {
+	MAX_CACHE_SIZE = 32
+};
+
+// Tom Forsyth, "Linear-Speed Vertex Cache Optimisation"
+inline float forsythVertexScore(int cache_position, GLuint num_live_triangles)
+{
+	if (num_live_triangles == 0) return -1;
+	
+	float score = 0;
+	
+	if (cache_position >= 0)
+	{
+		if (cache_position < 3)
+		{
+			score = 0.75;
+		}
+		else
+		{
+			const float scale = 1.0f / (MAX_CACHE_SIZE - 3);
+			score = powf(1.0f - (cache_position - 3) * scale, 1.5f);
+		}
+	}
+	
+	return score + 2.0f * powf((float)num_live_triangles, -0.5f);
+}
+
+// triangle adjacency in CSR form
+struct TriangleAdjacency
+{
+	vector<GLuint> counts;
+	vector<GLuint> offsets;
+	vector<GLuint> triangles;
+	
+	void build(const GLuint* indices, size_t num_indices, size_t num_vertices)
+	{
+		counts.assign(num_vertices, 0);
+		offsets.assign(num_vertices, 0);
+		triangles.resize(num_indices);
+		
+		for (size_t i = 0; i < num_indices; i++)
+			counts[indices[i]]++;
+		
+		GLuint offset = 0;
+		
+		for (size_t i = 0; i < num_vertices; i++)
+		{
+			offsets[i] = offset;
+			offset += counts[i];
+		}
+		
+		vector<GLuint> fill(offsets);
+		
+		for (size_t i = 0; i < num_indices; i++)
+			triangles[fill[indices[i]]++] = i / 3;
+	}
+};
+
+}
+
+// reorder triangles for the post-transform vertex cache
+inline void optimizeVertexCache(GLuint* dst, const GLuint* indices, size_t num_indices, size_t num_vertices)
+{
+	const size_t num_triangles = num_indices / 3;
+	if (num_triangles == 0) return;
+	
+	detail::TriangleAdjacency adjacency;
+	adjacency.build(indices, num_indices, num_vertices);
+	
+	vector<GLuint> live_triangles(adjacency.counts);
+	vector<int> cache_position(num_vertices, -1);
+	vector<float> vertex_score(num_vertices);
+	
+	for (size_t i = 0; i < num_vertices; i++)
+		vertex_score[i] = detail::forsythVertexScore(-1, live_triangles[i]);
+	
+	vector<float> triangle_score(num_triangles);
+	vector<bool> emitted(num_triangles, false);
+	
+	for (size_t i = 0; i < num_triangles; i++)
+	{
+		const GLuint* t = &indices[i * 3];
+		triangle_score[i] = vertex_score[t[0]] + vertex_score[t[1]] + vertex_score[t[2]];
+	}
+	
+	GLuint cache[detail::MAX_CACHE_SIZE + 3];
+	GLuint next_cache[detail::MAX_CACHE_SIZE + 3];
+	size_t cache_count = 0;
+	
+	size_t cursor = 0;
+	GLuint best = ~0u;
+	
+	for (size_t n = 0; n < num_triangles; n++)
+	{
+		// nothing in the cache, take the next unused triangle
+		if (best == ~0u)
+		{
+			while (emitted[cursor]) cursor++;
+			best = cursor;
+		}
+		
+		const GLuint* t = &indices[best * 3];
+		
+		dst[n * 3 + 0] = t[0];
+		dst[n * 3 + 1] = t[1];
+		dst[n * 3 + 2] = t[2];
+		
+		emitted[best] = true;
+		
+		// push the triangle's vertices to the front of the LRU cache
+		size_t next_count = 0;
+		
+		for (int k = 0; k < 3; k++)
+		{
+			const GLuint v = t[k];
+			
+			// degenerate triangle
+			if ((k > 0 && v == t[0]) || (k > 1 && v == t[1])) continue;
+			
+			next_cache[next_count++] = v;
+			
+			// remove the triangle from the vertex's live list
+			GLuint* list = &adjacency.triangles[adjacency.offsets[v]];
+			GLuint& count = live_triangles[v];
+			
+			for (GLuint i = 0; i < count;)
+			{
+				if (list[i] == best) list[i] = list[--count];
+				else i++;
+			}
+		}
+		
+		for (size_t i = 0; i < cache_count; i++)
+		{
+			const GLuint v = cache[i];
+			if (v != t[0] && v != t[1] && v != t[2]) next_cache[next_count++] = v;
+		}
+		
+		// vertices falling out of the cache
+		for (size_t i = detail::MAX_CACHE_SIZE; i < next_count; i++)
+			cache_position[next_cache[i]] = -1;
+		
+		cache_count = std::min<size_t>(next_count, detail::MAX_CACHE_SIZE);
+		std::copy(next_cache, next_cache + cache_count, cache);
+		
+		// rescore vertices in the cache and their triangles
+		for (size_t i = 0; i < next_count; i++)
+		{
+			const GLuint v = next_cache[i];
+			const int position = i < cache_count ? (int)i : -1;
+			
+			cache_position[v] = position;
+			
+			const float score = detail::forsythVertexScore(position, live_triangles[v]);
+			const float delta = score - vertex_score[v];
+			vertex_score[v] = score;
+			
+			const GLuint* list = &adjacency.triangles[adjacency.offsets[v]];
+			
+			for (GLuint j = 0; j < live_triangles[v]; j++)
+				triangle_score[list[j]] += delta;
+		}
+		
+		best = ~0u;
+		float best_score = -1;
+		
+		for (size_t i = 0; i < cache_count; i++)
+		{
+			const GLuint v = cache[i];
+			const GLuint* list = &adjacency.triangles[adjacency.offsets[v]];
+			
+			for (GLuint j = 0; j < live_triangles[v]; j++)
+			{
+				if (triangle_score[list[j]] > best_score)
+				{
+					best = list[j];
+					best_score = triangle_score[list[j]];
+				}
+			}
+		}
+	}
+}
+
+// reorder clusters of a cache optimized triangle list so that outward
+// facing clusters are drawn first. clusters are split where the FIFO cache
+// restarts, and further wherever the running ACMR of the cluster drops
+// below `threshold` times the mesh ACMR, which keeps the vertex cache
+// efficiency within `threshold` of the input.
+inline void optimizeOverdraw(GLuint* dst, const GLuint* indices, size_t num_indices,
+							 const float* positions, size_t position_stride, size_t num_vertices,
+							 float threshold = 1.05f, size_t cache_size = 16)
+{
+	const size_t num_triangles = num_indices / 3;
+	if (num_triangles == 0) return;
+	
+	const float mesh_acmr = analyzeVertexCache(indices, num_indices, num_vertices, cache_size).acmr;
+	
+	// cluster boundaries
+	vector<GLuint> clusters;
+	
+	{
+		vector<size_t> timestamps(num_vertices, 0);
+		size_t time = cache_size + 1;
+		
+		size_t cluster_misses = 0;
+		size_t cluster_start = 0;
+		
+		for (size_t i = 0; i < num_triangles; i++)
+		{
+			size_t misses = 0;
+			
+			for (int k = 0; k < 3; k++)
+			{
+				const GLuint v = indices[i * 3 + k];
+				
+				if (time - timestamps[v] > cache_size)
+				{
+					timestamps[v] = time++;
+					misses++;
+				}
+			}
+			
+			const bool hard_boundary = misses == 3;
+			const bool soft_boundary = i > cluster_start
+				&& (float)cluster_misses / (i - cluster_start) <= threshold * mesh_acmr
+				&& misses > 1;
+			
+			if (i == 0 || hard_boundary || soft_boundary)
+			{
+				clusters.push_back(i);
+				cluster_start = i;
+				cluster_misses = 0;
+			}
+			
+			cluster_misses += misses;
+		}
+	}
+	
+	const size_t stride = position_stride / sizeof(float);
+	
+	// mesh centroid
+	float center[3] = { 0, 0, 0 };
+	
+	for (size_t i = 0; i < num_indices; i++)
+	{
+		const float* p = &positions[indices[i] * stride];
+		center[0] += p[0];
+		center[1] += p[1];
+		center[2] += p[2];
+	}
+	
+	for (int k = 0; k < 3; k++) center[k] /= num_indices;
+	
+	// sort key: how much the cluster faces away from the mesh center
+	vector<pair<float, GLuint> > order(clusters.size());
+	
+	for (size_t c = 0; c < clusters.size(); c++)
+	{
+		const size_t begin = clusters[c];
+		const size_t end = c + 1 < clusters.size() ? clusters[c + 1] : num_triangles;
+		
+		float centroid[3] = { 0, 0, 0 };
+		float normal[3] = { 0, 0, 0 };
+		float area = 0;
+		
+		for (size_t i = begin; i < end; i++)
+		{
+			const float* a = &positions[indices[i * 3 + 0] * stride];
+			const float* b = &positions[indices[i * 3 + 1] * stride];
+			const float* p = &positions[indices[i * 3 + 2] * stride];
+			
+			const float e0[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+			const float e1[3] = { p[0] - a[0], p[1] - a[1], p[2] - a[2] };
+			
+			const float n[3] = {
+				e0[1] * e1[2] - e0[2] * e1[1],
+				e0[2] * e1[0] - e0[0] * e1[2],
+				e0[0] * e1[1] - e0[1] * e1[0]
+			};
+			
+			const float w = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+			
+			for (int k = 0; k < 3; k++)
+			{
+				centroid[k] += (a[k] + b[k] + p[k]) * (w / 3);
+				normal[k] += n[k];
+			}
+			
+			area += w;
+		}
+		
+		float dot = 0;
+		
+		if (area > 0)
+		{
+			const float length = sqrtf(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+			
+			for (int k = 0; k < 3; k++)
+			{
+				const float n = length > 0 ? normal[k] / length : 0;
+				dot += (centroid[k] / area - center[k]) * n;
+			}
+		}
+		
+		order[c] = make_pair(-dot, (GLuint)c);
+	}
+	
+	std::stable_sort(order.begin(), order.end());
+	
+	size_t cursor = 0;
+	
+	for (size_t c = 0; c < order.size(); c++)
+	{
+		const GLuint cluster = order[c].second;
+		const size_t begin = clusters[cluster];
+		const size_t end = cluster + 1 < clusters.size() ? clusters[cluster + 1] : num_triangles;
+		
+		const size_t count = (end - begin) * 3;
+		std::copy(indices + begin * 3, indices + begin * 3 + count, dst + cursor);
+		cursor += count;
+	}
+}
+
+// remap table that renumbers vertices in order of first use, vertices that
+// are never referenced map to ~0. returns the number of used vertices.
+inline size_t optimizeVertexFetchRemap(vector<GLuint>& remap, const GLuint* indices, size_t num_indices, size_t num_vertices)
+{
+	remap.assign(num_vertices, ~0u);
+	
+	GLuint next = 0;
+	
+	for (size_t i = 0; i < num_indices; i++)
+	{
+		const GLuint v = indices[i];
+		if (remap[v] == ~0u) remap[v] = next++;
+	}
+	
+	return next;
+}
+
+// split a triangle list into meshlets of at most `max_vertices` unique
+// vertices and `max_triangles` triangles, keeping the triangle order.
+// meshlet i covers triangles [offsets[i], offsets[i + 1]).
+inline void buildMeshlets(vector<GLuint>& offsets, const GLuint* indices, size_t num_indices, size_t num_vertices,
+						  size_t max_vertices = 64, size_t max_triangles = 124)
+{
+	offsets.clear();
+	
+	const size_t num_triangles = num_indices / 3;
+	if (num_triangles == 0) return;
+	
+	// meshlet id that last used each vertex
+	vector<GLuint> used(num_vertices, ~0u);
+	
+	GLuint meshlet = 0;
+	size_t meshlet_vertices = 0;
+	size_t meshlet_triangles = 0;
+	
+	offsets.push_back(0);
+	
+	for (size_t i = 0; i < num_triangles; i++)
+	{
+		const GLuint* t = &indices[i * 3];
+		
+		size_t new_vertices = 0;
+		
+		for (int k = 0; k < 3; k++)
+		{
+			if (used[t[k]] != meshlet && (k == 0 || t[k] != t[0]) && (k < 2 || t[k] != t[1])) new_vertices++;
+		}
+		
+		if (meshlet_vertices + new_vertices > max_vertices || meshlet_triangles + 1 > max_triangles)
+		{
+			offsets.push_back(i);
+			
+			meshlet++;
+			meshlet_vertices = 0;
+			meshlet_triangles = 0;
+		}
+		
+		for (int k = 0; k < 3; k++)
+		{
+			if (used[t[k]] != meshlet)
+			{
+				used[t[k]] = meshlet;
+				meshlet_vertices++;
+			}
+		}
+		
+		meshlet_triangles++;
+	}
+	
+	offsets.push_back(num_triangles);
+}
+
+struct ClusterBounds
+{
+	float center[3];
+	float radius;
+	
+	// backface cone, the cluster can be culled when
+	// dot(center - camera, axis) >= cutoff * length(center - camera) + radius
+	float cone_axis[3];
+	float cone_cutoff;
+};
+
+inline ClusterBounds computeClusterBounds(const GLuint* indices, size_t num_indices,
+										  const float* positions, size_t position_stride)
+{
+	ClusterBounds bounds;
+	
+	const size_t stride = position_stride / sizeof(float);
+	
+	float min[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+	float max[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+	
+	for (size_t i = 0; i < num_indices; i++)
+	{
+		const float* p = &positions[indices[i] * stride];
+		
+		for (int k = 0; k < 3; k++)
+		{
+			min[k] = std::min(min[k], p[k]);
+			max[k] = std::max(max[k], p[k]);
+		}
+	}
+	
+	for (int k = 0; k < 3; k++)
+		bounds.center[k] = num_indices ? (min[k] + max[k]) * 0.5f : 0;
+	
+	float radius2 = 0;
+	
+	for (size_t i = 0; i < num_indices; i++)
+	{
+		const float* p = &positions[indices[i] * stride];
+		
+		const float d[3] = { p[0] - bounds.center[0], p[1] - bounds.center[1], p[2] - bounds.center[2] };
+		radius2 = std::max(radius2, d[0] * d[0] + d[1] * d[1] + d[2] * d[2]);
+	}
+	
+	bounds.radius = sqrtf(radius2);
+	
+	// normal cone
+	vector<float> normals;
+	normals.reserve(num_indices);
+	
+	float axis[3] = { 0, 0, 0 };
+	
+	for (size_t i = 0; i + 2 < num_indices; i += 3)
+	{
+		const float* a = &positions[indices[i + 0] * stride];
+		const float* b = &positions[indices[i + 1] * stride];
+		const float* c = &positions[indices[i + 2] * stride];
+		
+		const float e0[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+		const float e1[3] = { c[0] - a[0], c[1] - a[1], c[2] - a[2] };
+		
+		float n[3] = {
+			e0[1] * e1[2] - e0[2] * e1[1],
+			e0[2] * e1[0] - e0[0] * e1[2],
+			e0[0] * e1[1] - e0[1] * e1[0]
+		};
+		
+		const float length = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+		if (length == 0) continue;
+		
+		for (int k = 0; k < 3; k++)
+		{
+			n[k] /= length;
+			axis[k] += n[k];
+			normals.push_back(n[k]);
+		}
+	}
+	
+	const float axis_length = sqrtf(axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2]);
+	
+	float min_dot = 1;
+	
+	for (int k = 0; k < 3; k++)
+		bounds.cone_axis[k] = axis_length > 0 ? axis[k] / axis_length : 0;
+	
+	for (size_t i = 0; i < normals.size(); i += 3)
+	{
+		const float d = normals[i] * bounds.cone_axis[0]
+			+ normals[i + 1] * bounds.cone_axis[1]
+			+ normals[i + 2] * bounds.cone_axis[2];
+		
+		min_dot = std::min(min_dot, d);
+	}
+	
+	// a cone wider than a hemisphere can't be culled
+	bounds.cone_cutoff = (axis_length == 0 || min_dot <= 0) ? 1 : sqrtf(1 - min_dot * min_dot);
+	
+	return bounds;
+}
+
+namespace detail {
+
+// symmetric 4x4 error quadric, `w` is the accumulated plane weight
+struct Quadric
+{
+	double a00, a01, a02, a03;
+	double a11, a12, a13;
+	double a22, a23;
+	double a33;
+	double w;
+	
+	Quadric() : a00(0), a01(0), a02(0), a03(0), a11(0), a12(0), a13(0), a22(0), a23(0), a33(0), w(0) {}
+	
+	// plane a * x + b * y + c * z + d = 0 with a unit normal
+	void addPlane(double a, double b, double c, double d, double weight)
+	{
+		a00 += weight * a * a; a01 += weight * a * b; a02 += weight * a * c; a03 += weight * a * d;
+		a11 += weight * b * b; a12 += weight * b * c; a13 += weight * b * d;
+		a22 += weight * c * c; a23 += weight * c * d;
+		a33 += weight * d * d;
+		w += weight;
+	}
+	
+	void add(const Quadric& q)
+	{
+		a00 += q.a00; a01 += q.a01; a02 += q.a02; a03 += q.a03;
+		a11 += q.a11; a12 += q.a12; a13 += q.a13;
+		a22 += q.a22; a23 += q.a23;
+		a33 += q.a33;
+		w += q.w;
+	}
+	
+	// mean squared distance of p to the accumulated planes
+	double error(const float* p) const
+	{
+		const double x = p[0], y = p[1], z = p[2];
+		
+		const double e = a00 * x * x + 2 * a01 * x * y + 2 * a02 * x * z + 2 * a03 * x
+			+ a11 * y * y + 2 * a12 * y * z + 2 * a13 * y
+			+ a22 * z * z + 2 * a23 * z
+			+ a33;
+		
+		return w > 0 ? std::max(e / w, 0.0) : 0;
+	}
+};
+
+struct PositionLess
+{
+	const float* positions;
+	size_t stride;
+	
+	bool operator()(GLuint a, GLuint b) const
+	{
+		const float* pa = &positions[a * stride];
+		const float* pb = &positions[b * stride];
+		
+		if (pa[0] != pb[0]) return pa[0] < pb[0];
+		if (pa[1] != pb[1]) return pa[1] < pb[1];
+		return pa[2] < pb[2];
+	}
+};
+
+struct Collapse
+{
+	GLuint from, to;
+	double error;
+	
+	bool operator<(const Collapse& c) const { return error < c.error; }
+};
+
+inline void triangleNormal(float* n, const float* a, const float* b, const float* c)
+{
+	const float e0[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+	const float e1[3] = { c[0] - a[0], c[1] - a[1], c[2] - a[2] };
+	
+	n[0] = e0[1] * e1[2] - e0[2] * e1[1];
+	n[1] = e0[2] * e1[0] - e0[0] * e1[2];
+	n[2] = e0[0] * e1[1] - e0[1] * e1[0];
+}
+
+}
+
+// quadric error edge collapse (Garland & Heckbert). vertices only ever
+// collapse onto one of their neighbours, so the simplified indices stay
+// valid for every attribute of the original vertex buffer. vertices on
+// an attribute seam (same position, different index) or on a mesh border
+// are locked. `dst` needs room for `num_indices`, returns the number of
+// indices written. `result_error` receives the largest collapse error as
+// a distance in object space.
+inline size_t simplify(GLuint* dst, const GLuint* indices, size_t num_indices,
+					   const float* positions, size_t position_stride, size_t num_vertices,
+					   size_t target_index_count, float* result_error = NULL)
+{
+	const size_t stride = position_stride / sizeof(float);
+	
+	vector<GLuint> result(indices, indices + num_indices);
+	double max_error = 0;
+	
+	// group vertices sharing a position
+	vector<GLuint> position_remap(num_vertices);
+	vector<bool> locked(num_vertices, false);
+	
+	{
+		vector<GLuint> order(num_vertices);
+		for (size_t i = 0; i < num_vertices; i++) order[i] = i;
+		
+		detail::PositionLess less = { positions, stride };
+		std::sort(order.begin(), order.end(), less);
+		
+		for (size_t i = 0; i < num_vertices; )
+		{
+			size_t j = i + 1;
+			while (j < num_vertices && !less(order[i], order[j])) j++;
+			
+			for (size_t k = i; k < j; k++)
+			{
+				position_remap[order[k]] = order[i];
+				if (j - i > 1) locked[order[k]] = true;
+			}
+			
+			i = j;
+		}
+	}
+	
+	// an edge without its opposite half edge lies on the border
+	{
+		vector<std::pair<GLuint, GLuint> > edges;
+		edges.reserve(num_indices);
+		
+		for (size_t i = 0; i + 2 < num_indices; i += 3)
+		{
+			for (int k = 0; k < 3; k++)
+			{
+				const GLuint a = position_remap[indices[i + k]];
+				const GLuint b = position_remap[indices[i + (k + 1) % 3]];
+				edges.push_back(std::make_pair(a, b));
+			}
+		}
+		
+		std::sort(edges.begin(), edges.end());
+		
+		for (size_t i = 0; i + 2 < num_indices; i += 3)
+		{
+			for (int k = 0; k < 3; k++)
+			{
+				const GLuint a = indices[i + k];
+				const GLuint b = indices[i + (k + 1) % 3];
+				
+				if (!std::binary_search(edges.begin(), edges.end(), std::make_pair(position_remap[b], position_remap[a])))
+				{
+					locked[a] = true;
+					locked[b] = true;
+				}
+			}
+		}
+	}
+	
+	vector<detail::Quadric> quadrics(num_vertices);
+	
+	for (size_t i = 0; i + 2 < num_indices; i += 3)
+	{
+		const float* a = &positions[indices[i + 0] * stride];
+		const float* b = &positions[indices[i + 1] * stride];
+		const float* c = &positions[indices[i + 2] * stride];
+		
+		float n[3];
+		detail::triangleNormal(n, a, b, c);
+		
+		const float length = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+		if (length == 0) continue;
+		
+		n[0] /= length;
+		n[1] /= length;
+		n[2] /= length;
+		
+		detail::Quadric q;
+		q.addPlane(n[0], n[1], n[2], -(n[0] * a[0] + n[1] * a[1] + n[2] * a[2]), length * 0.5f);
+		
+		for (int k = 0; k < 3; k++)
+			quadrics[indices[i + k]].add(q);
+	}
+	
+	detail::TriangleAdjacency adjacency;
+	vector<detail::Collapse> collapses;
+	vector<GLuint> remap(num_vertices);
+	vector<bool> touched(num_vertices);
+	
+	while (result.size() > target_index_count)
+	{
+		const size_t num_triangles = result.size() / 3;
+		adjacency.build(result.data(), result.size(), num_vertices);
+		
+		// cheapest direction of every edge
+		collapses.clear();
+		
+		for (size_t i = 0; i < result.size(); i += 3)
+		{
+			for (int k = 0; k < 3; k++)
+			{
+				const GLuint a = result[i + k];
+				const GLuint b = result[i + (k + 1) % 3];
+				
+				// interior edges show up twice, the duplicate is skipped as touched
+				if (a == b) continue;
+				
+				detail::Quadric q = quadrics[a];
+				q.add(quadrics[b]);
+				
+				detail::Collapse c;
+				c.error = DBL_MAX;
+				
+				if (!locked[a]) { c.from = a; c.to = b; c.error = q.error(&positions[b * stride]); }
+				
+				if (!locked[b])
+				{
+					const double e = q.error(&positions[a * stride]);
+					if (e < c.error) { c.from = b; c.to = a; c.error = e; }
+				}
+				
+				if (c.error != DBL_MAX) collapses.push_back(c);
+			}
+		}
+		
+		std::sort(collapses.begin(), collapses.end());
+		
+		for (size_t i = 0; i < num_vertices; i++) remap[i] = i;
+		touched.assign(num_vertices, false);
+		
+		size_t num_removed = 0;
+		size_t num_collapsed = 0;
+		
+		for (size_t i = 0; i < collapses.size(); i++)
+		{
+			if (result.size() - num_removed * 3 <= target_index_count) break;
+			
+			const detail::Collapse& c = collapses[i];
+			if (touched[c.from] || touched[c.to]) continue;
+			
+			const GLuint* tris = &adjacency.triangles[adjacency.offsets[c.from]];
+			const GLuint count = adjacency.counts[c.from];
+			
+			// moving `from` onto `to` must not flip any remaining triangle
+			bool flipped = false;
+			size_t removed = 0;
+			
+			for (GLuint t = 0; t < count && !flipped; t++)
+			{
+				const GLuint* tri = &result[tris[t] * 3];
+				
+				if (tri[0] == c.to || tri[1] == c.to || tri[2] == c.to)
+				{
+					removed++;
+					continue;
+				}
+				
+				const float* p[3];
+				const float* q[3];
+				
+				for (int k = 0; k < 3; k++)
+				{
+					p[k] = &positions[tri[k] * stride];
+					q[k] = tri[k] == c.from ? &positions[c.to * stride] : p[k];
+				}
+				
+				float n0[3], n1[3];
+				detail::triangleNormal(n0, p[0], p[1], p[2]);
+				detail::triangleNormal(n1, q[0], q[1], q[2]);
+				
+				flipped = n0[0] * n1[0] + n0[1] * n1[1] + n0[2] * n1[2] <= 0;
+			}
+			
+			if (flipped) continue;
+			
+			remap[c.from] = c.to;
+			quadrics[c.to].add(quadrics[c.from]);
+			
+			max_error = std::max(max_error, c.error);
+			
+			// neighbours of `from` see new edge costs, leave them to the next pass
+			for (GLuint t = 0; t < count; t++)
+			{
+				const GLuint* tri = &result[tris[t] * 3];
+				touched[tri[0]] = touched[tri[1]] = touched[tri[2]] = true;
+			}
+			
+			num_removed += removed;
+			num_collapsed++;
+		}
+		
+		if (num_collapsed == 0) break;
+		
+		// drop the triangles that became degenerate
+		size_t write = 0;
+		
+		for (size_t i = 0; i < num_triangles; i++)
+		{
+			const GLuint a = remap[result[i * 3 + 0]];
+			const GLuint b = remap[result[i * 3 + 1]];
+			const GLuint c = remap[result[i * 3 + 2]];
+			
+			if (a == b || b == c || c == a) continue;
+			
+			result[write++] = a;
+			result[write++] = b;
+			result[write++] = c;
+		}
+		
+		result.resize(write);
+	}
+	
+	std::copy(result.begin(), result.end(), dst);
+	
+	if (result_error) *result_error = sqrtf((float)max_error);
+	
+	return result.size();
+}
+
+}
+
+OFX_OPENGL_PRIMITIVES_END_NAMESPACE
@@ -28,13 +28,97 @@ private:
 	OpenGLObject& operator=(const OpenGLObject&) {}
 };
 
+#pragma mark - Fence
+
+class Fence
+{
+public:
+	
+	Fence() : sync(NULL) {}
+	
+	~Fence()
+	{
+		clear();
+	}
+	
+	// insert a fence after the commands issued so far
+	void lock()
+	{
+		clear();
+		sync = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	}
+	
+	// returns true once the GPU has passed the fence, never blocks
+	bool isSignaled()
+	{
+		if (sync == NULL) return true;
+		
+		GLenum result = glClientWaitSync(sync, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+		if (result == GL_ALREADY_SIGNALED || result == GL_CONDITION_SATISFIED)
+		{
+			clear();
+			return true;
+		}
+		
+		return false;
+	}
+	
+	// blocks until the GPU has passed the fence
+	bool wait()
+	{
+		if (sync == NULL) return true;
+		
+		GLbitfield flags = GL_SYNC_FLUSH_COMMANDS_BIT;
+		
+		while (true)
+		{
+			GLenum result = glClientWaitSync(sync, flags, 1000000 /* 1ms */);
+			
+			if (result == GL_ALREADY_SIGNALED || result == GL_CONDITION_SATISFIED)
+			{
+				clear();
+				return true;
+			}
+			
+			if (result == GL_WAIT_FAILED)
+			{
+				checkError();
+				clear();
+				return false;
+			}
+			
+			flags = 0;
+		}
+	}
+	
+	void clear()
+	{
+		if (sync == NULL) return;
+		
+		glDeleteSync(sync);
+		sync = NULL;
+	}
+	
+	bool isLocked() const { return sync != NULL; }
+	
+private:
+	
+	GLsync sync;
+	
+	Fence(const Fence&) {}
+	Fence& operator=(const Fence&) { return *this; }
+};
+
 #pragma mark - Buffer
 
 class Buffer : public OpenGLObject
 {
 public:
 	
-	Buffer(GLenum target) : target(target)
+	Buffer(GLenum target)
+		: target(target)
+		, usage(GL_STATIC_DRAW)
+		, num_bytes(0)
 	{
 		glGenBuffers(1, &handle);
 		assert(handle != 0);
@@ -57,11 +141,23 @@ public:
 		glBindBuffer(target, NULL);
 	}
 	
+	// attach to an indexed binding point, e.g. GL_TRANSFORM_FEEDBACK_BUFFER
+	void bindBase(GLenum target, GLuint index)
+	{
+		glBindBufferBase(target, index, handle);
+	}
+	
+	void bindRange(GLenum target, GLuint index, GLintptr offset, GLsizeiptr size)
+	{
+		glBindBufferRange(target, index, handle, offset, size);
+	}
+	
 	//
 	
 	inline void allocate(const GLvoid *data, GLsizeiptr num_bytes, GLenum usage)
 	{
 		this->num_bytes = num_bytes;
+		this->usage = usage;
 		
 		glBufferData(target, num_bytes, data, usage);
 		checkError();
@@ -70,7 +166,7 @@ public:
 	template <typename T>
 	inline void allocate(const vector<T>& data, GLenum usage)
 	{
-		allocate(usage, data.data(), sizeof(T) * data.size(), usage);
+		allocate(data.data(), sizeof(T) * data.size(), usage);
 	}
 	
 	inline void allocate(GLsizeiptr num_bytes, GLenum usage)
@@ -84,6 +180,28 @@ public:
 		allocate(sizeof(T) * size, usage);
 	}
 	
+	// keeps the current storage if it is large enough, otherwise grows it
+	// geometrically. returns true if the buffer was reallocated.
+	inline bool reserve(GLsizeiptr num_bytes, GLenum usage)
+	{
+		if (num_bytes <= this->num_bytes && usage == this->usage) return false;
+		
+		GLsizeiptr capacity = this->num_bytes + this->num_bytes / 2;
+		if (capacity < num_bytes) capacity = num_bytes;
+		
+		allocate(capacity, usage);
+		return true;
+	}
+	
+	// detach the storage in use by the GPU so the next upload doesn't stall
+	inline void orphan()
+	{
+		glBufferData(target, num_bytes, NULL, usage);
+	}
+	
+	GLsizeiptr getSize() const { return num_bytes; }
+	GLenum getUsage() const { return usage; }
+	
 	//
 	
 	void setData(const GLvoid * data, GLsizei size, GLenum usage)
@@ -103,17 +221,204 @@ public:
 		return glMapBuffer(target, access);
 	}
 	
+	void* mapRange(GLintptr offset, GLsizeiptr length, GLbitfield access)
+	{
+		return glMapBufferRange(target, offset, length, access);
+	}
+	
+	// only valid for mappings made with BufferMapAccess::FLUSH_EXPLICIT,
+	// offset is relative to the start of the mapped range
+	void flushRange(GLintptr offset, GLsizeiptr length)
+	{
+		glFlushMappedBufferRange(target, offset, length);
+	}
+	
 	void unmap()
 	{
 		glUnmapBuffer(target);
 	}
 	
+	GLenum getTarget() const { return target; }
+	
 protected:
 	
 	GLenum target;
 	GLenum usage;
 	
-	size_t num_bytes;
+	GLsizeiptr num_bytes;
+};
+
+#pragma mark - ScopedMapping
+
+// maps a range of a buffer for the lifetime of the object
+//
+//	{
+//		ScopedMapping m(buffer, offset, length, BufferMapAccess::WRITE | BufferMapAccess::UNSYNCHRONIZED);
+//		memcpy(m.getPtr(), src, length);
+//	}
+class ScopedMapping
+{
+public:
+	
+	ScopedMapping(Buffer& buffer, GLintptr offset, GLsizeiptr length, GLbitfield access)
+		: buffer(buffer)
+		, length(length)
+		, access(access)
+	{
+		buffer.bind();
+		ptr = buffer.mapRange(offset, length, access);
+		
+		if (ptr == NULL) checkError();
+	}
+	
+	~ScopedMapping()
+	{
+		if (ptr == NULL) return;
+		
+		buffer.bind();
+		buffer.unmap();
+	}
+	
+	bool isValid() const { return ptr != NULL; }
+	
+	GLvoid* getPtr() const { return ptr; }
+	
+	template <typename T>
+	T* get() const { return (T*)ptr; }
+	
+	GLsizeiptr getLength() const { return length; }
+	
+	// offset is relative to the start of the mapping
+	void flush(GLintptr offset, GLsizeiptr length)
+	{
+		assert(access & GL_MAP_FLUSH_EXPLICIT_BIT);
+		
+		buffer.bind();
+		buffer.flushRange(offset, length);
+	}
+	
+	void flush() { flush(0, length); }
+	
+private:
+	
+	Buffer& buffer;
+	GLvoid* ptr;
+	
+	GLsizeiptr length;
+	GLbitfield access;
+	
+	ScopedMapping(const ScopedMapping&);
+	ScopedMapping& operator=(const ScopedMapping&);
+};
+
+#pragma mark - StreamBuffer
+
+// persistently mapped buffer split into `num_regions` regions. the CPU
+// fills one region per frame while the GPU still reads the previous ones,
+// each region is guarded by a fence.
+//
+//	stream.begin();
+//	attr.end(stream);   // writes straight into the mapped region
+//	... draw ...
+//	stream.end();
+//
+// the storage is immutable and stays mapped, so the members of Buffer
+// that respecify or map it are hidden.
+class StreamBuffer : public Buffer
+{
+public:
+	OFX_OPENGL_PRIMITIVES_DEFINE_REFERENCE(StreamBuffer);
+	
+	enum {
+		ALIGNMENT = 256
+	};
+	
+	StreamBuffer(GLenum target, GLsizeiptr region_size, int num_regions = 3)
+		: Buffer(target)
+		, region_size(align(region_size))
+		, current(0)
+		, cursor(0)
+		, mapped_ptr(NULL)
+	{
+		for (int i = 0; i < num_regions; i++)
+			fences.push_back(ofPtr<Fence>(new Fence));
+		
+		const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		
+		num_bytes = this->region_size * num_regions;
+		usage = GL_STREAM_DRAW;
+		
+		bind();
+		glBufferStorage(target, num_bytes, NULL, flags);
+		mapped_ptr = (GLubyte*)glMapBufferRange(target, 0, num_bytes, flags);
+		unbind();
+		
+		checkError();
+		assert(mapped_ptr != NULL);
+	}
+	
+	~StreamBuffer()
+	{
+		bind();
+		glUnmapBuffer(target);
+		unbind();
+	}
+	
+	// wait until the GPU is done with the current region
+	void begin()
+	{
+		fences[current]->wait();
+		cursor = 0;
+	}
+	
+	// fence the current region after the draws using it, and move on
+	void end()
+	{
+		fences[current]->lock();
+		current = (current + 1) % fences.size();
+	}
+	
+	// reserve `size` bytes in the current region. returns the write pointer
+	// and the offset to bind at, or NULL if the region is full.
+	GLubyte* acquire(GLsizeiptr size, GLintptr& offset)
+	{
+		if (cursor + size > region_size) return NULL;
+		
+		offset = current * region_size + cursor;
+		cursor += align(size);
+		
+		return mapped_ptr + offset;
+	}
+	
+	GLsizeiptr getRegionSize() const { return region_size; }
+	int getNumRegions() const { return fences.size(); }
+	
+protected:
+	
+	GLsizeiptr region_size;
+	vector<ofPtr<Fence> > fences;
+	
+	int current;
+	GLsizeiptr cursor;
+	
+	GLubyte* mapped_ptr;
+	
+	static GLsizeiptr align(GLsizeiptr size)
+	{
+		return (size + ALIGNMENT - 1) & ~(GLsizeiptr)(ALIGNMENT - 1);
+	}
+	
+private:
+	
+	using Buffer::allocate;
+	using Buffer::reserve;
+	using Buffer::orphan;
+	using Buffer::setData;
+	using Buffer::setSubData;
+	using Buffer::map;
+	using Buffer::mapRange;
+	using Buffer::flushRange;
+	using Buffer::unmap;
 };
 
 #pragma mark - VertexBuffer
@@ -196,10 +501,21 @@ public:
 	OFX_OPENGL_PRIMITIVES_DEFINE_REFERENCE(PixelBuffer);
 	
 	// TODO: constructor takes width and height param
-	PixelBuffer(GLenum target) : Buffer(target) {}
+	PixelBuffer(GLenum target)
+		: Buffer(target)
+		, width(0)
+		, height(0)
+		, format(GL_RGBA)
+		, type(GL_UNSIGNED_BYTE)
+	{}
 	
 	void copy(int x, int y, int width, int height, GLenum format = GL_RGBA, GLenum type = GL_UNSIGNED_BYTE)
 	{
+		this->width = width;
+		this->height = height;
+		this->format = format;
+		this->type = type;
+		
 		glReadPixels(x, y, width, height, format, type, NULL);
 		checkError();
 	}
@@ -219,6 +535,78 @@ public:
 		glDrawBuffer(mode);
 	}
 	
+	GLsizei getWidth() const { return width; }
+	GLsizei getHeight() const { return height; }
+	GLenum getFormat() const { return format; }
+	GLenum getType() const { return type; }
+	
+	// tightly packed image size, assumes GL_PACK_ALIGNMENT / GL_UNPACK_ALIGNMENT = 1
+	static GLsizeiptr getNumBytes(GLsizei width, GLsizei height, GLenum format, GLenum type)
+	{
+		return (GLsizeiptr)width * height * getBytesPerPixel(format, type);
+	}
+	
+	static size_t getBytesPerPixel(GLenum format, GLenum type)
+	{
+		switch (type)
+		{
+			case GL_UNSIGNED_BYTE_3_3_2:
+			case GL_UNSIGNED_BYTE_2_3_3_REV:
+				return 1;
+				
+			case GL_UNSIGNED_SHORT_5_6_5:
+			case GL_UNSIGNED_SHORT_5_6_5_REV:
+			case GL_UNSIGNED_SHORT_4_4_4_4:
+			case GL_UNSIGNED_SHORT_4_4_4_4_REV:
+			case GL_UNSIGNED_SHORT_5_5_5_1:
+			case GL_UNSIGNED_SHORT_1_5_5_5_REV:
+				return 2;
+				
+			case GL_UNSIGNED_INT_8_8_8_8:
+			case GL_UNSIGNED_INT_8_8_8_8_REV:
+			case GL_UNSIGNED_INT_10_10_10_2:
+			case GL_UNSIGNED_INT_2_10_10_10_REV:
+			case GL_UNSIGNED_INT_24_8:
+				return 4;
+		}
+		
+		size_t num_channels = 4;
+		
+		switch (format)
+		{
+			case GL_RED:
+			case GL_RED_INTEGER:
+			case GL_STENCIL_INDEX:
+			case GL_DEPTH_COMPONENT:
+				num_channels = 1; break;
+				
+			case GL_RG:
+			case GL_RG_INTEGER:
+			case GL_DEPTH_STENCIL:
+				num_channels = 2; break;
+				
+			case GL_RGB:
+			case GL_BGR:
+			case GL_RGB_INTEGER:
+			case GL_BGR_INTEGER:
+				num_channels = 3; break;
+		}
+		
+		switch (type)
+		{
+			case GL_BYTE:
+			case GL_UNSIGNED_BYTE:
+				return num_channels;
+				
+			case GL_SHORT:
+			case GL_UNSIGNED_SHORT:
+			case GL_HALF_FLOAT:
+				return num_channels * 2;
+		}
+		
+		return num_channels * 4;
+	}
+	
 protected:
 	
 	GLsizei width;
@@ -138,6 +138,16 @@ template <>
 void bind_attribute_location_helper<NullAttribute>(GLuint handle) {
 }
 
+template <typename T>
+inline void append_varying_helper(vector<string>& varyings, const string& prefix) {
+	(void)sizeof(TransformFeedbackAttributeMustBeFloat<T::IsCapturable>);
+	varyings.push_back(prefix + T::getAttributeName());
+}
+
+template <>
+inline void append_varying_helper<NullAttribute>(vector<string>& varyings, const string& prefix) {
+}
+
 }
 
 class AbstructProgram
@@ -199,6 +209,16 @@ public:
 		return result;
 	}
 	
+	// outputs captured by a TransformFeedback, in buffer order. takes
+	// effect at the next link() and survives reset().
+	void setTransformFeedbackVaryings(const vector<string>& varyings, GLenum buffer_mode = GL_INTERLEAVED_ATTRIBS)
+	{
+		vector<const GLchar*> names(varyings.size());
+		for (size_t i = 0; i < varyings.size(); i++) names[i] = varyings[i].c_str();
+		
+		glTransformFeedbackVaryings(handle, names.size(), names.empty() ? NULL : &names[0], buffer_mode);
+	}
+	
 	/// set uniforms
 
 #define GL_UNIFORM_DEFINE_CHECK_EXISTS() \
@@ -218,7 +238,7 @@ public:
 		const detail::UniformData* o = getUniformData(name); \
 		GL_UNIFORM_DEFINE_CHECK_EXISTS() \
 		if (o->is_valid<LONG_TYPE, N>(count)) { \
-			glUniform1 ## SHORT_TYPE ## v(o->location, count, data); \
+			glUniform ## N ## SHORT_TYPE ## v(o->location, count, data); \
 		} else { GL_UNIFORM_DEFINE_TYPE_ERROR(LONG_TYPE, N) } \
 	}
 	
@@ -354,6 +374,32 @@ protected:
 	vector<detail::UniformData> uniforms;
 	map<string, detail::UniformData*> uniform_map;
 	
+	bool linkProgram()
+	{
+		glLinkProgram(handle);
+		
+		GLint result;
+		glGetProgramiv(handle, GL_LINK_STATUS, &result);
+		
+		if (result)
+		{
+			collectProgramInfo();
+			return true;
+		}
+		
+		GLint length;
+		glGetProgramiv(handle, GL_INFO_LOG_LENGTH, &length);
+		
+		string err_str(length, '\0');
+		GLchar* err_str_ptr = (GLchar*)err_str.c_str();
+		
+		glGetProgramInfoLog(handle, length, NULL, err_str_ptr);
+		
+		cerr << err_str;
+		
+		return false;
+	}
+	
 	void collectProgramInfo()
 	{
 		{
@@ -460,29 +506,63 @@ public:
 		detail::bind_attribute_location_helper<T6>(handle);
 		detail::bind_attribute_location_helper<T7>(handle);
 		
-		glLinkProgram(handle);
-		
-		GLint result;
-		glGetProgramiv(handle, GL_LINK_STATUS, &result);
-		
-		if (result)
-		{
-			collectProgramInfo();
-			return true;
-		}
-		
-		GLint length;
-		glGetProgramiv(handle, GL_INFO_LOG_LENGTH, &length);
+		return linkProgram();
+	}
+	
+	using AbstructProgram::setTransformFeedbackVaryings;
+	
+	// capture `prefix` + attribute name for Vertex, T0, ... T7, the order
+	// Geometry_<T0, ...> stores them in. use GL_INTERLEAVED_ATTRIBS for
+	// VertexLayout::Interleaved. call before link(). only GL_FLOAT
+	// attributes can be captured, others like Color or PackedNormal don't
+	// compile.
+	//
+	//	out vec3 out_position;
+	//	out vec3 out_normal;
+	void setTransformFeedbackVaryings(const string& prefix, GLenum buffer_mode = GL_SEPARATE_ATTRIBS)
+	{
+		vector<string> varyings;
 		
-		string err_str(length, '\0');
-		GLchar* err_str_ptr = (GLchar*)err_str.c_str();
+		detail::append_varying_helper<Vertex>(varyings, prefix);
+		detail::append_varying_helper<T0>(varyings, prefix);
+		detail::append_varying_helper<T1>(varyings, prefix);
+		detail::append_varying_helper<T2>(varyings, prefix);
+		detail::append_varying_helper<T3>(varyings, prefix);
+		detail::append_varying_helper<T4>(varyings, prefix);
+		detail::append_varying_helper<T5>(varyings, prefix);
+		detail::append_varying_helper<T6>(varyings, prefix);
+		detail::append_varying_helper<T7>(varyings, prefix);
 		
-		glGetProgramInfoLog(handle, length, NULL, err_str_ptr);
+		AbstructProgram::setTransformFeedbackVaryings(varyings, buffer_mode);
+	}
+};
+
+#pragma mark - ComputeProgram
+
+class ComputeProgram : public AbstructProgram
+{
+public:
+
+	bool load(const string& code)
+	{
+		reset();
 		
-		cerr << err_str;
+		ofPtr<Shader> shader = Shader::fromSource(GL_COMPUTE_SHADER, code);
+		if (!shader) return false;
 		
-		return false;
+		attach(shader);
+		return link();
+	}
+	
+	bool link() { return linkProgram(); }
+	
+	// between use() and release()
+	void dispatch(GLuint x, GLuint y = 1, GLuint z = 1) const
+	{
+		glDispatchCompute(x, y, z);
 	}
+	
+	static GLuint getNumGroups(GLuint n, GLuint local_size) { return (n + local_size - 1) / local_size; }
 };
 
 OFX_OPENGL_PRIMITIVES_END_NAMESPACE
\ No newline at end of file
@@ -0,0 +1,148 @@
+#pragma once
+
+#include "ofxOpenGLPrimitives/Object.h"
+
+OFX_OPENGL_PRIMITIVES_BEGIN_NAMESPACE
+
+#pragma mark - ReadbackQueue
+
+// asynchronous glReadPixels through a ring of pixel pack buffers.
+// request() only queues the copy on the GPU, poll() hands the pixels
+// over once the fence of the copy has been passed.
+//
+//	void onFrame(const ReadbackQueue::Request& req, const GLvoid* pixels);
+//
+//	queue.request(0, 0, w, h);
+//	queue.poll(onFrame);
+class ReadbackQueue
+{
+public:
+	OFX_OPENGL_PRIMITIVES_DEFINE_REFERENCE(ReadbackQueue);
+	
+	struct Request
+	{
+		int x, y;
+		GLsizei width, height;
+		GLenum format, type;
+		
+		unsigned long frame;
+		
+		GLsizeiptr getNumBytes() const { return PixelBuffer::getNumBytes(width, height, format, type); }
+	};
+	
+	ReadbackQueue(int num_buffers = 3)
+		: head(0)
+		, num_pending(0)
+		, num_requested(0)
+	{
+		for (int i = 0; i < num_buffers; i++)
+		{
+			Slot s;
+			s.pbo = ofPtr<PixelBuffer>(new PixelBuffer(GL_PIXEL_PACK_BUFFER));
+			s.fence = ofPtr<Fence>(new Fence);
+			slots.push_back(s);
+		}
+	}
+	
+	// queue a copy of the current read framebuffer. returns false if every
+	// buffer is still in flight, call poll(callback, true) to make room.
+	bool request(int x, int y, GLsizei width, GLsizei height, GLenum format = GL_RGBA, GLenum type = GL_UNSIGNED_BYTE)
+	{
+		if (num_pending == slots.size()) return false;
+		
+		Slot& s = slots[head];
+		
+		s.request.x = x;
+		s.request.y = y;
+		s.request.width = width;
+		s.request.height = height;
+		s.request.format = format;
+		s.request.type = type;
+		s.request.frame = num_requested++;
+		
+		GLint alignment;
+		glGetIntegerv(GL_PACK_ALIGNMENT, &alignment);
+		glPixelStorei(GL_PACK_ALIGNMENT, 1);
+		
+		s.pbo->bind();
+		
+		if (!s.pbo->reserve(s.request.getNumBytes(), GL_STREAM_READ))
+			s.pbo->orphan();
+		
+		s.pbo->copy(x, y, width, height, format, type);
+		s.pbo->unbind();
+		
+		glPixelStorei(GL_PACK_ALIGNMENT, alignment);
+		
+		s.fence->lock();
+		
+		head = (head + 1) % slots.size();
+		num_pending++;
+		
+		return true;
+	}
+	
+	bool request(GLsizei width, GLsizei height, GLenum format = GL_RGBA, GLenum type = GL_UNSIGNED_BYTE)
+	{
+		return request(0, 0, width, height, format, type);
+	}
+	
+	// call `callback(const Request&, const GLvoid* pixels)` for each finished
+	// copy, oldest first. the pointer is only valid inside the callback.
+	// with `wait` the oldest pending copy is waited for. returns the number
+	// of delivered copies. lvalue functors keep their state, temporaries
+	// like poll(Handler()) need a const operator().
+	template <typename Callback>
+	int poll(Callback& callback, bool wait = false) { return deliver<Callback>(callback, wait); }
+	
+	template <typename Callback>
+	int poll(const Callback& callback, bool wait = false) { return deliver<const Callback>(callback, wait); }
+	
+	size_t getNumPending() const { return num_pending; }
+	size_t getNumBuffers() const { return slots.size(); }
+	
+protected:
+	
+	template <typename Callback>
+	int deliver(Callback& callback, bool wait)
+	{
+		int n = 0;
+		
+		while (num_pending > 0)
+		{
+			Slot& s = slots[(head + slots.size() - num_pending) % slots.size()];
+			
+			if (wait && n == 0) s.fence->wait();
+			else if (!s.fence->isSignaled()) break;
+			
+			s.pbo->bind();
+			
+			const GLvoid* pixels = s.pbo->map(GL_READ_ONLY);
+			if (pixels) callback(s.request, pixels);
+			else checkError();
+			
+			s.pbo->unmap();
+			s.pbo->unbind();
+			
+			num_pending--;
+			n++;
+		}
+		
+		return n;
+	}
+	
+	struct Slot
+	{
+		ofPtr<PixelBuffer> pbo;
+		ofPtr<Fence> fence;
+		Request request;
+	};
+	
+	vector<Slot> slots;
+	
+	size_t head;
+	size_t num_pending;
+	unsigned long num_requested;
+};
+
+OFX_OPENGL_PRIMITIVES_END_NAMESPACE
@@ -0,0 +1,520 @@
+#pragma once
+
+#include "ofxOpenGLPrimitives/Util.h"
+
+OFX_OPENGL_PRIMITIVES_BEGIN_NAMESPACE
+
+#pragma mark - SceneBVH
+
+// bounding volume hierarchy over instance bounds. build() runs a binned
+// SAH split, refit() follows moving instances without rebuilding. nodes
+// live in one flat array of 32 bytes each, the children of a node are
+// stored next to each other and after their parent.
+//
+// the leaves hold contiguous ranges of getItems(), the instance ids in
+// tree order, and are returned whole by query(). reorder the instance
+// stream the same way once and a frustum query yields ranges that can be
+// drawn as they are:
+//
+//	bvh.build(&bounds[0], bounds.size());
+//	bvh.getRemap(remap);
+//	instances.remap(remap, remap.size());
+//	instances.end();
+//
+//	bvh.query(frustum, ranges);
+//	for (size_t i = 0; i < ranges.size(); i++)
+//		geom.drawInstanced(ranges[i].second, ranges[i].first);
+//
+// bounds passed to refit() are still indexed by instance id.
+class SceneBVH
+{
+public:
+	OFX_OPENGL_PRIMITIVES_DEFINE_REFERENCE(SceneBVH);
+	
+	// (first, count) in tree order
+	typedef std::pair<GLuint, GLuint> Range;
+	
+	enum {
+		INVALID = 0xFFFFFFFF,
+		MAX_LEAF_SIZE = 4,
+		NUM_BINS = 16
+	};
+	
+	struct Node
+	{
+		Bounds bounds;
+		
+		// leaves: first item and item count. inner nodes: left child, the
+		// right one follows it, and a count of 0.
+		GLuint first;
+		GLuint count;
+		
+		bool isLeaf() const { return count > 0; }
+	};
+	
+	void build(const Bounds* bounds, size_t count);
+	
+	// recompute every node from new instance bounds
+	void refit(const Bounds* bounds);
+	
+	// only walk up from the leaves of `moved` instances
+	void refit(const Bounds* bounds, const GLuint* moved, size_t num_moved);
+	
+	// visible instances as ranges of the tree order, neighbours are merged.
+	// returns the number of visible instances.
+	size_t query(const Frustum& frustum, vector<Range>& ranges) const;
+	
+	// nearest instance whose box the ray hits, `direction` needn't be
+	// normalized, `distance` is in its units
+	bool intersect(const ofVec3f& origin, const ofVec3f& direction, GLuint& instance, float& distance,
+				   float max_distance = std::numeric_limits<float>::infinity()) const;
+	
+	void clear()
+	{
+		nodes.clear();
+		items.clear();
+		item_bounds.clear();
+		parents.clear();
+		leaves.clear();
+	}
+	
+	bool isEmpty() const { return nodes.empty(); }
+	
+	const vector<Node>& getNodes() const { return nodes; }
+	const vector<GLuint>& getItems() const { return items; }
+	
+	// remap[instance] = position in tree order, as taken by
+	// VertexAttribute_::remap()
+	void getRemap(vector<GLuint>& remap) const
+	{
+		remap.resize(items.size());
+		for (size_t i = 0; i < items.size(); i++) remap[items[i]] = i;
+	}
+	
+	const Bounds& getBounds() const { return nodes.front().bounds; }
+
+protected:
+
+	vector<Node> nodes;
+	vector<GLuint> items;
+	
+	// instance bounds in tree order
+	vector<Bounds> item_bounds;
+	
+	// only used by refit()
+	vector<GLuint> parents;
+	vector<GLuint> leaves;
+	
+	void split(GLuint node, vector<ofVec3f>& centers);
+	
+	void updateLeaf(Node& node) const
+	{
+		node.bounds.clear();
+		for (GLuint i = 0; i < node.count; i++) node.bounds.add(item_bounds[node.first + i]);
+	}
+	
+	void updateInner(Node& node) const
+	{
+		node.bounds = nodes[node.first].bounds;
+		node.bounds.add(nodes[node.first + 1].bounds);
+	}
+	
+	static float getArea(const Bounds& b)
+	{
+		if (b.isEmpty()) return 0;
+		
+		const ofVec3f d = b.max - b.min;
+		return d.x * d.y + d.y * d.z + d.z * d.x;
+	}
+	
+	// slab test, the entry distance or infinity on a miss
+	static float intersectBox(const Bounds& b, const ofVec3f& origin, const ofVec3f& inv_dir, float t_max)
+	{
+		// empty bounds are +-inf and would pass as a hit at 0
+		if (b.isEmpty()) return std::numeric_limits<float>::infinity();
+		
+		float t0 = 0, t1 = t_max;
+		
+		for (int axis = 0; axis < 3; axis++)
+		{
+			float near_t = (b.min[axis] - origin[axis]) * inv_dir[axis];
+			float far_t = (b.max[axis] - origin[axis]) * inv_dir[axis];
+			
+			if (near_t > far_t) std::swap(near_t, far_t);
+			
+			// NaN from 0 * inf leaves the interval alone
+			if (near_t > t0) t0 = near_t;
+			if (far_t < t1) t1 = far_t;
+			
+			if (t0 > t1) return std::numeric_limits<float>::infinity();
+		}
+		
+		return t0;
+	}
+	
+	static void addRange(vector<Range>& ranges, GLuint first, GLuint count)
+	{
+		if (!ranges.empty() && ranges.back().first + ranges.back().second == first)
+			ranges.back().second += count;
+		else
+			ranges.push_back(Range(first, count));
+	}
+};
+
+inline void SceneBVH::build(const Bounds* bounds, size_t count)
+{
+	clear();
+	
+	if (count == 0) return;
+	
+	items.resize(count);
+	for (size_t i = 0; i < count; i++) items[i] = i;
+	
+	// split() keeps these in tree order along with the ids, so every pass
+	// reads them front to back
+	item_bounds.assign(bounds, bounds + count);
+	
+	vector<ofVec3f> centers(count);
+	
+	// empty bounds go to the origin instead of spreading NaNs
+	for (size_t i = 0; i < count; i++)
+		centers[i] = bounds[i].isEmpty() ? ofVec3f(0, 0, 0) : bounds[i].getCenter();
+	
+	nodes.reserve(2 * count);
+	
+	Node root;
+	root.first = 0;
+	root.count = count;
+	
+	nodes.push_back(root);
+	parents.push_back(INVALID);
+	
+	// children are always appended behind their parent, so walking the
+	// array in order splits every node
+	for (GLuint i = 0; i < nodes.size(); i++)
+		split(i, centers);
+	
+	leaves.resize(count);
+	
+	for (GLuint i = 0; i < nodes.size(); i++)
+	{
+		const Node& n = nodes[i];
+		for (GLuint k = 0; k < n.count; k++) leaves[items[n.first + k]] = i;
+	}
+}
+
+inline void SceneBVH::split(GLuint index, vector<ofVec3f>& centers)
+{
+	const GLuint first = nodes[index].first;
+	const GLuint count = nodes[index].count;
+	
+	nodes[index].bounds.clear();
+	for (GLuint i = first; i < first + count; i++) nodes[index].bounds.add(item_bounds[i]);
+	
+	if (count <= MAX_LEAF_SIZE) return;
+	
+	Bounds centroid_bounds;
+	for (GLuint i = first; i < first + count; i++) centroid_bounds.add(centers[i]);
+	
+	// find the cheapest bin boundary on any axis
+	int best_axis = -1;
+	int best_split = 0;
+	float best_cost = getArea(nodes[index].bounds) * count;
+	
+	for (int axis = 0; axis < 3; axis++)
+	{
+		const float lo = centroid_bounds.min[axis];
+		const float extent = centroid_bounds.max[axis] - lo;
+		
+		if (extent <= 0) continue;
+		
+		const float scale = NUM_BINS / extent;
+		
+		Bounds bin_bounds[NUM_BINS];
+		GLuint bin_count[NUM_BINS] = { 0 };
+		
+		for (GLuint i = first; i < first + count; i++)
+		{
+			const int bin = std::min((int)((centers[i][axis] - lo) * scale), (int)NUM_BINS - 1);
+			
+			bin_bounds[bin].add(item_bounds[i]);
+			bin_count[bin]++;
+		}
+		
+		// sweep from the right, then from the left
+		float right_area[NUM_BINS];
+		GLuint right_count[NUM_BINS];
+		
+		Bounds b;
+		GLuint n = 0;
+		
+		for (int i = NUM_BINS - 1; i > 0; i--)
+		{
+			b.add(bin_bounds[i]);
+			n += bin_count[i];
+			
+			right_area[i] = getArea(b);
+			right_count[i] = n;
+		}
+		
+		b.clear();
+		n = 0;
+		
+		for (int i = 0; i < NUM_BINS - 1; i++)
+		{
+			b.add(bin_bounds[i]);
+			n += bin_count[i];
+			
+			if (n == 0 || right_count[i + 1] == 0) continue;
+			
+			const float cost = getArea(b) * n + right_area[i + 1] * right_count[i + 1];
+			
+			if (cost < best_cost)
+			{
+				best_cost = cost;
+				best_axis = axis;
+				best_split = i + 1;
+			}
+		}
+	}
+	
+	GLuint mid = first;
+	
+	if (best_axis >= 0)
+	{
+		const float lo = centroid_bounds.min[best_axis];
+		const float scale = NUM_BINS / (centroid_bounds.max[best_axis] - lo);
+		
+		GLuint end = first + count;
+		mid = first;
+		
+		while (mid < end)
+		{
+			const int bin = std::min((int)((centers[mid][best_axis] - lo) * scale), (int)NUM_BINS - 1);
+			
+			if (bin < best_split)
+			{
+				mid++;
+				continue;
+			}
+			
+			end--;
+			
+			std::swap(items[mid], items[end]);
+			std::swap(item_bounds[mid], item_bounds[end]);
+			std::swap(centers[mid], centers[end]);
+		}
+	}
+	else if (count > 4 * MAX_LEAF_SIZE)
+	{
+		// SAH prefers a leaf but it would get too large, fall back to a
+		// median split along the widest axis
+		const ofVec3f d = centroid_bounds.max - centroid_bounds.min;
+		const int axis = d.x > d.y ? (d.x > d.z ? 0 : 2) : (d.y > d.z ? 1 : 2);
+		
+		mid = first + count / 2;
+		
+		vector<std::pair<float, GLuint> > order(count);
+		for (GLuint i = 0; i < count; i++) order[i] = std::make_pair(centers[first + i][axis], first + i);
+		
+		std::nth_element(order.begin(), order.begin() + count / 2, order.end());
+		
+		const vector<GLuint> old_items(items.begin() + first, items.begin() + first + count);
+		const vector<Bounds> old_bounds(item_bounds.begin() + first, item_bounds.begin() + first + count);
+		const vector<ofVec3f> old_centers(centers.begin() + first, centers.begin() + first + count);
+		
+		for (GLuint i = 0; i < count; i++)
+		{
+			const GLuint src = order[i].second - first;
+			
+			items[first + i] = old_items[src];
+			item_bounds[first + i] = old_bounds[src];
+			centers[first + i] = old_centers[src];
+		}
+	}
+	else
+	{
+		return;
+	}
+	
+	const GLuint left = nodes.size();
+	
+	Node child;
+	
+	child.first = first;
+	child.count = mid - first;
+	nodes.push_back(child);
+	
+	child.first = mid;
+	child.count = first + count - mid;
+	nodes.push_back(child);
+	
+	parents.push_back(index);
+	parents.push_back(index);
+	
+	nodes[index].first = left;
+	nodes[index].count = 0;
+}
+
+inline void SceneBVH::refit(const Bounds* bounds)
+{
+	for (size_t i = 0; i < items.size(); i++) item_bounds[i] = bounds[items[i]];
+	
+	for (size_t i = nodes.size(); i-- > 0;)
+	{
+		Node& n = nodes[i];
+		
+		if (n.isLeaf()) updateLeaf(n);
+		else updateInner(n);
+	}
+}
+
+inline void SceneBVH::refit(const Bounds* bounds, const GLuint* moved, size_t num_moved)
+{
+	for (size_t i = 0; i < num_moved; i++)
+	{
+		GLuint index = leaves[moved[i]];
+		Node& leaf = nodes[index];
+		
+		for (GLuint k = leaf.first; k < leaf.first + leaf.count; k++)
+		{
+			if (items[k] == moved[i]) item_bounds[k] = bounds[moved[i]];
+		}
+		
+		updateLeaf(leaf);
+		
+		// stop as soon as a node comes out unchanged
+		for (index = parents[index]; index != INVALID; index = parents[index])
+		{
+			Node& n = nodes[index];
+			const Bounds old = n.bounds;
+			
+			updateInner(n);
+			
+			if (old.min == n.bounds.min && old.max == n.bounds.max) break;
+		}
+	}
+}
+
+inline size_t SceneBVH::query(const Frustum& frustum, vector<Range>& ranges) const
+{
+	ranges.clear();
+	
+	if (nodes.empty()) return 0;
+	
+	size_t num_visible = 0;
+	
+	// node index and the planes it still straddles
+	vector<std::pair<GLuint, GLuint> > stack;
+	stack.reserve(64);
+	stack.push_back(std::make_pair(0u, 0x3Fu));
+	
+	while (!stack.empty())
+	{
+		const GLuint index = stack.back().first;
+		GLuint planes = stack.back().second;
+		
+		stack.pop_back();
+		
+		const Node& n = nodes[index];
+		if (n.bounds.isEmpty()) continue;
+		
+		bool culled = false;
+		
+		for (int i = 0; i < 6 && planes; i++)
+		{
+			if (!(planes & (1 << i))) continue;
+			
+			const ofVec4f& p = frustum.getPlane(i);
+			const Bounds& b = n.bounds;
+			
+			// positive and negative vertex
+			const float d_max = p.x * (p.x >= 0 ? b.max.x : b.min.x)
+							  + p.y * (p.y >= 0 ? b.max.y : b.min.y)
+							  + p.z * (p.z >= 0 ? b.max.z : b.min.z) + p.w;
+			
+			if (d_max < 0)
+			{
+				culled = true;
+				break;
+			}
+			
+			const float d_min = p.x * (p.x >= 0 ? b.min.x : b.max.x)
+							  + p.y * (p.y >= 0 ? b.min.y : b.max.y)
+							  + p.z * (p.z >= 0 ? b.min.z : b.max.z) + p.w;
+			
+			if (d_min >= 0) planes &= ~(1 << i);
+		}
+		
+		if (culled) continue;
+		
+		if (n.isLeaf())
+		{
+			addRange(ranges, n.first, n.count);
+			num_visible += n.count;
+			continue;
+		}
+		
+		// right first, so ranges come out in tree order
+		stack.push_back(std::make_pair(n.first + 1, planes));
+		stack.push_back(std::make_pair(n.first, planes));
+	}
+	
+	return num_visible;
+}
+
+inline bool SceneBVH::intersect(const ofVec3f& origin, const ofVec3f& direction, GLuint& instance, float& distance,
+								float max_distance) const
+{
+	if (nodes.empty()) return false;
+	
+	const ofVec3f inv_dir(1 / direction.x, 1 / direction.y, 1 / direction.z);
+	
+	bool found = false;
+	distance = max_distance;
+	
+	vector<GLuint> stack;
+	stack.reserve(64);
+	
+	if (intersectBox(nodes[0].bounds, origin, inv_dir, distance) < distance)
+		stack.push_back(0);
+	
+	while (!stack.empty())
+	{
+		const Node& n = nodes[stack.back()];
+		stack.pop_back();
+		
+		if (n.isLeaf())
+		{
+			for (GLuint i = n.first; i < n.first + n.count; i++)
+			{
+				const float t = intersectBox(item_bounds[i], origin, inv_dir, distance);
+				
+				if (t < distance)
+				{
+					distance = t;
+					instance = items[i];
+					found = true;
+				}
+			}
+			
+			continue;
+		}
+		
+		// push the nearer child last so it is visited first
+		const float t_left = intersectBox(nodes[n.first].bounds, origin, inv_dir, distance);
+		const float t_right = intersectBox(nodes[n.first + 1].bounds, origin, inv_dir, distance);
+		
+		const bool left_first = t_left <= t_right;
+		
+		const GLuint near_child = left_first ? n.first : n.first + 1;
+		const GLuint far_child = left_first ? n.first + 1 : n.first;
+		
+		if (std::max(t_left, t_right) < distance) stack.push_back(far_child);
+		if (std::min(t_left, t_right) < distance) stack.push_back(near_child);
+	}
+	
+	return found;
+}
+
+OFX_OPENGL_PRIMITIVES_END_NAMESPACE
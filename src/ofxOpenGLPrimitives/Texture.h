@@ -146,6 +146,14 @@ public:
 						pixels);
 		checkError();
 	}
+	
+	// source the pixels from an unpack buffer instead of client memory
+	void update(PixelBuffer& pbo, GLintptr offset = 0)
+	{
+		pbo.bind();
+		update((const GLvoid*)offset);
+		pbo.unbind();
+	}
 
 	void draw(int x, int y)
 	{
@@ -213,5 +221,109 @@ protected:
 	{}
 };
 
+#pragma mark - TextureUploadQueue
+
+// streams frames into a Texture2D through a ring of pixel unpack buffers.
+// map() and commit() must be called on the GL thread, the returned
+// pointer can be filled from any thread in between.
+//
+//	GLvoid* dst = queue.map();      // next free buffer
+//	decode(dst);                    // on a worker thread
+//	queue.commit(texture);          // oldest mapped buffer -> texture
+class TextureUploadQueue
+{
+public:
+	OFX_OPENGL_PRIMITIVES_DEFINE_REFERENCE(TextureUploadQueue);
+	
+	TextureUploadQueue(const Texture2D& texture, int num_buffers = 3)
+		: num_bytes(PixelBuffer::getNumBytes(texture.getWidth(), texture.getHeight(), texture.getFormat(), texture.getType()))
+		, head(0)
+		, num_mapped(0)
+	{
+		for (int i = 0; i < num_buffers; i++)
+		{
+			Slot s;
+			s.pbo = ofPtr<PixelBuffer>(new PixelBuffer(GL_PIXEL_UNPACK_BUFFER));
+			s.fence = ofPtr<Fence>(new Fence);
+			
+			s.pbo->bind();
+			s.pbo->allocate(num_bytes, GL_STREAM_DRAW);
+			s.pbo->unbind();
+			
+			slots.push_back(s);
+		}
+	}
+	
+	// map the next free buffer for writing, waits if the GPU still reads
+	// from it. returns NULL if every buffer is already mapped.
+	GLvoid* map()
+	{
+		if (num_mapped == slots.size()) return NULL;
+		
+		Slot& s = slots[(head + num_mapped) % slots.size()];
+		s.fence->wait();
+		
+		s.pbo->bind();
+		GLvoid* ptr = s.pbo->map(GL_WRITE_ONLY);
+		s.pbo->unbind();
+		
+		if (ptr == NULL)
+		{
+			checkError();
+			return NULL;
+		}
+		
+		num_mapped++;
+		return ptr;
+	}
+	
+	// upload the oldest mapped buffer. returns false if nothing is mapped.
+	bool commit(Texture2D& texture)
+	{
+		if (num_mapped == 0) return false;
+		
+		Slot& s = slots[head];
+		
+		GLint alignment;
+		glGetIntegerv(GL_UNPACK_ALIGNMENT, &alignment);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		
+		s.pbo->bind();
+		s.pbo->unmap();
+		
+		texture.bind();
+		texture.update(*s.pbo);
+		texture.unbind();
+		
+		s.pbo->unbind();
+		
+		glPixelStorei(GL_UNPACK_ALIGNMENT, alignment);
+		
+		s.fence->lock();
+		
+		head = (head + 1) % slots.size();
+		num_mapped--;
+		
+		return true;
+	}
+	
+	GLsizeiptr getNumBytes() const { return num_bytes; }
+	size_t getNumMapped() const { return num_mapped; }
+	
+protected:
+	
+	struct Slot
+	{
+		ofPtr<PixelBuffer> pbo;
+		ofPtr<Fence> fence;
+	};
+	
+	vector<Slot> slots;
+	
+	GLsizeiptr num_bytes;
+	
+	size_t head;
+	size_t num_mapped;
+};
 
 OFX_OPENGL_PRIMITIVES_END_NAMESPACE
\ No newline at end of file
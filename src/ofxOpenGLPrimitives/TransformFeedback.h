@@ -0,0 +1,126 @@
+#pragma once
+
+#include "ofxOpenGLPrimitives/Object.h"
+
+OFX_OPENGL_PRIMITIVES_BEGIN_NAMESPACE
+
+#pragma mark - TransformFeedback
+
+// captures the vertex (or geometry) shader outputs of the draws between
+// begin() and end() into buffers, and remembers how many vertices were
+// written so draw() can consume them without a readback. a particle
+// system ping-pongs between two geometries of the same size:
+//
+//	typedef Geometry_<Normal, NullType1, ..., VertexLayout::Interleaved> Particles;
+//	Particles particles[2];   // both begin(GL_POINTS) ... end() with the initial state
+//
+//	update.setTransformFeedbackVaryings("out_", GL_INTERLEAVED_ATTRIBS);
+//	loader.load("update", update);
+//
+//	feedback[dst].attach(particles[dst]);   // once
+//
+//	update.use();
+//	feedback[dst].begin(GL_POINTS);
+//	particles[src].draw();
+//	feedback[dst].end();
+//	update.release();
+//
+//	render.use();
+//	particles[dst].use();
+//	feedback[dst].draw(GL_POINTS);
+//	particles[dst].release();
+//	render.release();
+//
+// the captured count lives in the object, so keep one per target.
+class TransformFeedback : public OpenGLObject
+{
+public:
+	OFX_OPENGL_PRIMITIVES_DEFINE_REFERENCE(TransformFeedback);
+	
+	TransformFeedback()
+		: discard(false)
+	{
+		glGenTransformFeedbacks(1, &handle);
+		assert(handle != 0);
+	}
+	
+	~TransformFeedback()
+	{
+		glDeleteTransformFeedbacks(1, &handle);
+	}
+	
+	void bind()
+	{
+		glBindTransformFeedback(GL_TRANSFORM_FEEDBACK, handle);
+	}
+	
+	void unbind()
+	{
+		glBindTransformFeedback(GL_TRANSFORM_FEEDBACK, 0);
+	}
+	
+	// the buffer bindings are state of this object, attach once
+	void attach(Buffer& buffer, GLuint index = 0)
+	{
+		bind();
+		buffer.bindBase(GL_TRANSFORM_FEEDBACK_BUFFER, index);
+		unbind();
+	}
+	
+	void attach(Buffer& buffer, GLuint index, GLintptr offset, GLsizeiptr size)
+	{
+		bind();
+		buffer.bindRange(GL_TRANSFORM_FEEDBACK_BUFFER, index, offset, size);
+		unbind();
+	}
+	
+	// the vertex buffer of a VertexAttribute_ or Geometry_, see
+	// VertexAttribute_::bindTransformFeedbackBuffers()
+	template <typename T>
+	void attach(T& attribute, GLuint first_index = 0)
+	{
+		bind();
+		attribute.bindTransformFeedbackBuffers(first_index);
+		unbind();
+	}
+	
+	// primitive_mode is GL_POINTS, GL_LINES or GL_TRIANGLES and has to
+	// match the draws. with discard set nothing is rasterized.
+	void begin(GLenum primitive_mode, bool discard = true)
+	{
+		this->discard = discard;
+		
+		bind();
+		if (discard) glEnable(GL_RASTERIZER_DISCARD);
+		glBeginTransformFeedback(primitive_mode);
+	}
+	
+	void end()
+	{
+		glEndTransformFeedback();
+		if (discard) glDisable(GL_RASTERIZER_DISCARD);
+		unbind();
+	}
+	
+	// between begin() and end(), to draw something without capturing it
+	void pause() { glPauseTransformFeedback(); }
+	void resume() { glResumeTransformFeedback(); }
+	
+	// draw the vertices written by the last capture with the VAO of the
+	// captured buffer bound
+	void draw(GLenum mode) const
+	{
+		glDrawTransformFeedback(mode, handle);
+	}
+	
+	void drawInstanced(GLenum mode, GLsizei primcount) const
+	{
+		glDrawTransformFeedbackInstanced(mode, handle, primcount);
+	}
+
+protected:
+
+	bool discard;
+};
+
+OFX_OPENGL_PRIMITIVES_END_NAMESPACE
@@ -0,0 +1,143 @@
+#pragma once
+
+#include "ofxOpenGLPrimitives/Util.h"
+#include "ofxOpenGLPrimitives/GeometryImage.h"
+
+OFX_OPENGL_PRIMITIVES_BEGIN_NAMESPACE
+
+namespace detail {
+
+struct UploadTask
+{
+	virtual ~UploadTask() {}
+	virtual bool run() = 0;
+	virtual size_t getNumBytes() const = 0;
+};
+
+template <typename Target>
+struct UploadTask_ : public UploadTask
+{
+	Target* target;
+	ofPtr<GeometryImage> image;
+	
+	UploadTask_(Target* target, const ofPtr<GeometryImage>& image) : target(target), image(image) {}
+	
+	bool run() { return target->upload(*image); }
+	size_t getNumBytes() const { return image->getNumBytes(); }
+};
+
+}
+
+#pragma mark - UploadQueue
+
+// hands baked geometry from worker threads to the GL thread. push() can be
+// called from any thread, update() runs on the GL thread and uploads until
+// the byte budget of the frame is used up. an image is never split, so one
+// larger than the budget still goes through on its own.
+//
+//	// worker
+//	Geometry_<Normal> tmp;
+//	tmp.begin(GL_TRIANGLES);
+//	...
+//	ofPtr<GeometryImage> image(new GeometryImage);
+//	tmp.bake(*image);
+//	queue.push(mesh, image);
+//
+//	// GL thread, every frame
+//	queue.update(4 * 1024 * 1024);
+class UploadQueue
+{
+public:
+	OFX_OPENGL_PRIMITIVES_DEFINE_REFERENCE(UploadQueue);
+	
+	UploadQueue() : num_pending_bytes(0) {}
+	
+	~UploadQueue()
+	{
+		for (size_t i = 0; i < tasks.size(); i++)
+			delete tasks[i];
+	}
+	
+	// `target` must stay alive until its upload ran
+	template <typename Target>
+	void push(Target& target, const ofPtr<GeometryImage>& image)
+	{
+		if (!image || !image->isValid())
+		{
+			ofLogError("UploadQueue") << "push() needs a baked image";
+			return;
+		}
+		
+		ofScopedLock lock(mutex);
+		
+		tasks.push_back(new detail::UploadTask_<Target>(&target, image));
+		num_pending_bytes += image->getNumBytes();
+	}
+	
+	// GL thread only. returns the number of bytes uploaded.
+	size_t update(size_t byte_budget)
+	{
+		vector<detail::UploadTask*> ready;
+		size_t num_bytes = 0;
+		
+		{
+			ofScopedLock lock(mutex);
+			
+			size_t n = 0;
+			
+			while (n < tasks.size()
+				   && (n == 0 || num_bytes + tasks[n]->getNumBytes() <= byte_budget))
+			{
+				num_bytes += tasks[n]->getNumBytes();
+				n++;
+			}
+			
+			ready.assign(tasks.begin(), tasks.begin() + n);
+			tasks.erase(tasks.begin(), tasks.begin() + n);
+			
+			num_pending_bytes -= num_bytes;
+		}
+		
+		// upload outside the lock so workers never wait on GL
+		for (size_t i = 0; i < ready.size(); i++)
+		{
+			if (!ready[i]->run())
+				ofLogError("UploadQueue") << "upload failed";
+			
+			delete ready[i];
+		}
+		
+		return num_bytes;
+	}
+	
+	// upload everything that is queued
+	void flush()
+	{
+		while (!isEmpty())
+			update(getNumPendingBytes());
+	}
+	
+	bool isEmpty()
+	{
+		ofScopedLock lock(mutex);
+		return tasks.empty();
+	}
+	
+	size_t getNumPendingBytes()
+	{
+		ofScopedLock lock(mutex);
+		return num_pending_bytes;
+	}
+
+private:
+
+	ofMutex mutex;
+	
+	deque<detail::UploadTask*> tasks;
+	size_t num_pending_bytes;
+	
+	UploadQueue(const UploadQueue&);
+	UploadQueue& operator=(const UploadQueue&);
+};
+
+OFX_OPENGL_PRIMITIVES_END_NAMESPACE
@@ -1,5 +1,14 @@
 #include "ofxOpenGLPrimitives/Util.h"
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define OFX_OPENGL_PRIMITIVES_SSE2
+#include <emmintrin.h>
+#endif
+
+#ifdef __AVX__
+#include <immintrin.h>
+#endif
+
 OFX_OPENGL_PRIMITIVES_BEGIN_NAMESPACE
 
 bool checkError(int err)
@@ -19,4 +28,335 @@ bool checkError()
 	return checkError(glGetError());
 }
 
+#pragma mark - Bounds
+
+void Bounds::add(const ofVec3f* points, size_t count)
+{
+	size_t i = 0;
+
+#ifdef OFX_OPENGL_PRIMITIVES_SSE2
+	if (count >= 4)
+	{
+		// 4 packed points are 3 vectors of xyzx yzxy zxyz, reduce each lane
+		// on its own and sort the lanes out at the end
+		const float* p = points[0].getPtr();
+		
+		__m128 min_a = _mm_loadu_ps(p), min_b = _mm_loadu_ps(p + 4), min_c = _mm_loadu_ps(p + 8);
+		__m128 max_a = min_a, max_b = min_b, max_c = min_c;
+		
+		for (i = 4; i + 4 <= count; i += 4)
+		{
+			p = points[i].getPtr();
+			
+			const __m128 a = _mm_loadu_ps(p);
+			const __m128 b = _mm_loadu_ps(p + 4);
+			const __m128 c = _mm_loadu_ps(p + 8);
+			
+			min_a = _mm_min_ps(min_a, a);
+			min_b = _mm_min_ps(min_b, b);
+			min_c = _mm_min_ps(min_c, c);
+			
+			max_a = _mm_max_ps(max_a, a);
+			max_b = _mm_max_ps(max_b, b);
+			max_c = _mm_max_ps(max_c, c);
+		}
+		
+		float lo[12], hi[12];
+		
+		_mm_storeu_ps(lo, min_a);
+		_mm_storeu_ps(lo + 4, min_b);
+		_mm_storeu_ps(lo + 8, min_c);
+		
+		_mm_storeu_ps(hi, max_a);
+		_mm_storeu_ps(hi + 4, max_b);
+		_mm_storeu_ps(hi + 8, max_c);
+		
+		for (int k = 0; k < 12; k += 3)
+		{
+			add(ofVec3f(lo[k], lo[k + 1], lo[k + 2]));
+			add(ofVec3f(hi[k], hi[k + 1], hi[k + 2]));
+		}
+	}
+#endif
+
+	for (; i < count; i++)
+		add(points[i]);
+}
+
+void Bounds::add(const ofVec3f* points, const GLuint* indices, size_t count)
+{
+	for (size_t i = 0; i < count; i++)
+	{
+		if (indices[i] != ~0u) add(points[indices[i]]);
+	}
+}
+
+#pragma mark - Frustum
+
+namespace {
+
+// elements per thread task, smaller batches stay on the calling thread
+const size_t CULL_BLOCK_SIZE = 8192;
+
+inline size_t countBits(unsigned int v)
+{
+	v = v - ((v >> 1) & 0x55555555);
+	v = (v & 0x33333333) + ((v >> 2) & 0x33333333);
+	return (((v + (v >> 4)) & 0x0F0F0F0F) * 0x01010101) >> 24;
+}
+
+// the planes, also splatted across SSE lanes once per call
+struct PlaneSet
+{
+	const ofVec4f* planes;
+
+#ifdef OFX_OPENGL_PRIMITIVES_SSE2
+	__m128 nx[6], ny[6], nz[6], nw[6];
+#endif
+
+	PlaneSet(const ofVec4f* planes) : planes(planes)
+	{
+#ifdef OFX_OPENGL_PRIMITIVES_SSE2
+		for (int k = 0; k < 6; k++)
+		{
+			nx[k] = _mm_set1_ps(planes[k].x);
+			ny[k] = _mm_set1_ps(planes[k].y);
+			nz[k] = _mm_set1_ps(planes[k].z);
+			nw[k] = _mm_set1_ps(planes[k].w);
+		}
+#endif
+	}
+};
+
+// a sphere is visible when its center is at most `radius` behind every plane
+struct SphereTest : public PlaneSet
+{
+	const float *x, *y, *z, *radius;
+	
+	SphereTest(const ofVec4f* planes, const float* x, const float* y, const float* z, const float* radius)
+		: PlaneSet(planes)
+		, x(x)
+		, y(y)
+		, z(z)
+		, radius(radius)
+	{}
+	
+	bool operator()(size_t i) const
+	{
+		for (int k = 0; k < 6; k++)
+		{
+			const ofVec4f& p = planes[k];
+			if (x[i] * p.x + p.w + y[i] * p.y + z[i] * p.z + radius[i] < 0) return false;
+		}
+		
+		return true;
+	}
+
+#ifdef OFX_OPENGL_PRIMITIVES_SSE2
+	__m128 test4(size_t i) const
+	{
+		const __m128 px = _mm_loadu_ps(x + i);
+		const __m128 py = _mm_loadu_ps(y + i);
+		const __m128 pz = _mm_loadu_ps(z + i);
+		const __m128 r = _mm_loadu_ps(radius + i);
+		
+		__m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+		
+		for (int k = 0; k < 6; k++)
+		{
+			__m128 d = _mm_add_ps(_mm_mul_ps(px, nx[k]), nw[k]);
+			d = _mm_add_ps(d, _mm_mul_ps(py, ny[k]));
+			d = _mm_add_ps(d, _mm_mul_ps(pz, nz[k]));
+			d = _mm_add_ps(d, r);
+			
+			inside = _mm_and_ps(inside, _mm_cmpge_ps(d, _mm_setzero_ps()));
+		}
+		
+		return inside;
+	}
+#endif
+
+#ifdef __AVX__
+	__m256 test8(size_t i) const
+	{
+		const __m256 px = _mm256_loadu_ps(x + i);
+		const __m256 py = _mm256_loadu_ps(y + i);
+		const __m256 pz = _mm256_loadu_ps(z + i);
+		const __m256 r = _mm256_loadu_ps(radius + i);
+		
+		__m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+		
+		for (int k = 0; k < 6; k++)
+		{
+			const ofVec4f& p = planes[k];
+			
+			__m256 d = _mm256_add_ps(_mm256_mul_ps(px, _mm256_set1_ps(p.x)), _mm256_set1_ps(p.w));
+			d = _mm256_add_ps(d, _mm256_mul_ps(py, _mm256_set1_ps(p.y)));
+			d = _mm256_add_ps(d, _mm256_mul_ps(pz, _mm256_set1_ps(p.z)));
+			d = _mm256_add_ps(d, r);
+			
+			inside = _mm256_and_ps(inside, _mm256_cmp_ps(d, _mm256_setzero_ps(), _CMP_GE_OQ));
+		}
+		
+		return inside;
+	}
+#endif
+};
+
+// a box is visible when its corner farthest along each plane normal (the
+// positive vertex) is inside. the corner only depends on the plane, so it
+// is picked once per plane as a set of arrays.
+struct BoxTest : public PlaneSet
+{
+	const float* vx[6];
+	const float* vy[6];
+	const float* vz[6];
+	
+	BoxTest(const ofVec4f* planes,
+			const float* min_x, const float* min_y, const float* min_z,
+			const float* max_x, const float* max_y, const float* max_z)
+		: PlaneSet(planes)
+	{
+		for (int k = 0; k < 6; k++)
+		{
+			vx[k] = planes[k].x >= 0 ? max_x : min_x;
+			vy[k] = planes[k].y >= 0 ? max_y : min_y;
+			vz[k] = planes[k].z >= 0 ? max_z : min_z;
+		}
+	}
+	
+	bool operator()(size_t i) const
+	{
+		for (int k = 0; k < 6; k++)
+		{
+			const ofVec4f& p = planes[k];
+			if (vx[k][i] * p.x + p.w + vy[k][i] * p.y + vz[k][i] * p.z < 0) return false;
+		}
+		
+		return true;
+	}
+
+#ifdef OFX_OPENGL_PRIMITIVES_SSE2
+	__m128 test4(size_t i) const
+	{
+		__m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+		
+		for (int k = 0; k < 6; k++)
+		{
+			__m128 d = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(vx[k] + i), nx[k]), nw[k]);
+			d = _mm_add_ps(d, _mm_mul_ps(_mm_loadu_ps(vy[k] + i), ny[k]));
+			d = _mm_add_ps(d, _mm_mul_ps(_mm_loadu_ps(vz[k] + i), nz[k]));
+			
+			inside = _mm_and_ps(inside, _mm_cmpge_ps(d, _mm_setzero_ps()));
+		}
+		
+		return inside;
+	}
+#endif
+
+#ifdef __AVX__
+	__m256 test8(size_t i) const
+	{
+		__m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+		
+		for (int k = 0; k < 6; k++)
+		{
+			const ofVec4f& p = planes[k];
+			
+			__m256 d = _mm256_add_ps(_mm256_mul_ps(_mm256_loadu_ps(vx[k] + i), _mm256_set1_ps(p.x)), _mm256_set1_ps(p.w));
+			d = _mm256_add_ps(d, _mm256_mul_ps(_mm256_loadu_ps(vy[k] + i), _mm256_set1_ps(p.y)));
+			d = _mm256_add_ps(d, _mm256_mul_ps(_mm256_loadu_ps(vz[k] + i), _mm256_set1_ps(p.z)));
+			
+			inside = _mm256_and_ps(inside, _mm256_cmp_ps(d, _mm256_setzero_ps(), _CMP_GE_OQ));
+		}
+		
+		return inside;
+	}
+#endif
+};
+
+// 16 elements per step, the lane masks are packed down to one byte each
+// and stored at once
+template <typename Test>
+size_t cullRange(const Test& test, size_t first, size_t last, GLubyte* mask)
+{
+	size_t visible = 0;
+	size_t i = first;
+
+#ifdef OFX_OPENGL_PRIMITIVES_SSE2
+	const __m128i one = _mm_set1_epi8(1);
+	
+	for (; i + 16 <= last; i += 16)
+	{
+#ifdef __AVX__
+		const __m256 m0 = test.test8(i);
+		const __m256 m1 = test.test8(i + 8);
+		
+		const __m128i a = _mm_packs_epi32(_mm_castps_si128(_mm256_castps256_ps128(m0)),
+										  _mm_castps_si128(_mm256_extractf128_ps(m0, 1)));
+		const __m128i b = _mm_packs_epi32(_mm_castps_si128(_mm256_castps256_ps128(m1)),
+										  _mm_castps_si128(_mm256_extractf128_ps(m1, 1)));
+#else
+		const __m128i a = _mm_packs_epi32(_mm_castps_si128(test.test4(i)), _mm_castps_si128(test.test4(i + 4)));
+		const __m128i b = _mm_packs_epi32(_mm_castps_si128(test.test4(i + 8)), _mm_castps_si128(test.test4(i + 12)));
+#endif
+		const __m128i bytes = _mm_packs_epi16(a, b);
+		
+		_mm_storeu_si128((__m128i*)(mask + i), _mm_and_si128(bytes, one));
+		visible += countBits(_mm_movemask_epi8(bytes));
+	}
+#endif
+
+	for (; i < last; i++)
+	{
+		mask[i] = test(i);
+		visible += mask[i];
+	}
+	
+	return visible;
+}
+
+}
+
+size_t Frustum::cullSpheres(const float* x, const float* y, const float* z, const float* radius,
+							size_t count, GLubyte* mask) const
+{
+	const SphereTest test(planes, x, y, z, radius);
+	
+	const long num_blocks = (count + CULL_BLOCK_SIZE - 1) / CULL_BLOCK_SIZE;
+	size_t visible = 0;
+
+#pragma omp parallel for schedule(static) reduction(+:visible) if (num_blocks > 1)
+	for (long b = 0; b < num_blocks; b++)
+	{
+		const size_t first = b * CULL_BLOCK_SIZE;
+		const size_t last = std::min(first + CULL_BLOCK_SIZE, count);
+		
+		visible += cullRange(test, first, last, mask);
+	}
+	
+	return visible;
+}
+
+size_t Frustum::cullBoxes(const float* min_x, const float* min_y, const float* min_z,
+						  const float* max_x, const float* max_y, const float* max_z,
+						  size_t count, GLubyte* mask) const
+{
+	const BoxTest test(planes, min_x, min_y, min_z, max_x, max_y, max_z);
+	
+	const long num_blocks = (count + CULL_BLOCK_SIZE - 1) / CULL_BLOCK_SIZE;
+	size_t visible = 0;
+
+#pragma omp parallel for schedule(static) reduction(+:visible) if (num_blocks > 1)
+	for (long b = 0; b < num_blocks; b++)
+	{
+		const size_t first = b * CULL_BLOCK_SIZE;
+		const size_t last = std::min(first + CULL_BLOCK_SIZE, count);
+		
+		visible += cullRange(test, first, last, mask);
+	}
+	
+	return visible;
+}
+
 OFX_OPENGL_PRIMITIVES_END_NAMESPACE
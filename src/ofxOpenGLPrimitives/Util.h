@@ -43,8 +43,77 @@ protected:
 	GLsizei width, height;
 };
 
+#pragma mark - Bounds
+
+// axis aligned box and the sphere around it, empty until the first add()
+struct Bounds
+{
+	ofVec3f min, max;
+	
+	Bounds() { clear(); }
+	
+	void clear()
+	{
+		min.set(std::numeric_limits<float>::infinity());
+		max.set(-std::numeric_limits<float>::infinity());
+	}
+	
+	bool isEmpty() const { return min.x > max.x; }
+	
+	void add(const ofVec3f& p)
+	{
+		min.x = std::min(min.x, p.x);
+		min.y = std::min(min.y, p.y);
+		min.z = std::min(min.z, p.z);
+		
+		max.x = std::max(max.x, p.x);
+		max.y = std::max(max.y, p.y);
+		max.z = std::max(max.z, p.z);
+	}
+	
+	void add(const Bounds& b)
+	{
+		if (b.isEmpty()) return;
+		
+		add(b.min);
+		add(b.max);
+	}
+	
+	// SIMD min / max over `count` packed points
+	void add(const ofVec3f* points, size_t count);
+	
+	// the points referenced by `indices`, restart indices (~0) are skipped
+	void add(const ofVec3f* points, const GLuint* indices, size_t count);
+	
+	ofVec3f getCenter() const { return (min + max) * 0.5f; }
+	ofVec3f getExtent() const { return (max - min) * 0.5f; }
+	
+	float getRadius() const { return isEmpty() ? 0 : getExtent().length(); }
+	
+	// center and radius in one, as taken by DrawBatch::add()
+	ofVec4f getSphere() const
+	{
+		if (isEmpty()) return ofVec4f(0, 0, 0, 0);
+		
+		const ofVec3f c = getCenter();
+		return ofVec4f(c.x, c.y, c.z, getRadius());
+	}
+};
+
 #pragma mark - Frustum
 
+// corner points for debug drawing and the six clip planes for culling.
+// planes are (normal, distance) with normalized normals pointing inside, a
+// point p is inside a plane when dot(plane.xyz, p) + plane.w >= 0.
+//
+// the batch tests take bounds as separate float arrays (SoA) and run 4 or 8
+// elements per step with SSE / AVX, split across threads when built with
+// OpenMP:
+//
+//	frustum.update(camera);
+//	size_t n = frustum.cullSpheres(&x[0], &y[0], &z[0], &r[0], x.size(), &mask[0]);
+//	visible.compact(instances, &mask[0]);
+//	visible.end();
 class Frustum
 {
 public:
@@ -70,6 +139,8 @@ public:
 		}
 		
 		zero = modelview_inv.preMult(ofVec3f::zero());
+		
+		setPlanes(modelview_inv.getInverse() * projection);
 	}
 	
 	void update(ofCamera& camera)
@@ -155,14 +226,98 @@ public:
 	{
 		for (int i = 0; i < 8; i++) points[i] = m.preMult(points[i]);
 		zero = m.preMult(zero);
+		
+		// planes go by the inverse transpose, p' = v * m means
+		// dot(plane, v) = dot(inv(m) * plane, p')
+		const ofMatrix4x4 inv = m.getInverse();
+		
+		for (int i = 0; i < 6; i++)
+		{
+			const ofVec4f p = planes[i];
+			
+			ofVec4f& q = planes[i];
+			q.x = inv(0, 0) * p.x + inv(0, 1) * p.y + inv(0, 2) * p.z + inv(0, 3) * p.w;
+			q.y = inv(1, 0) * p.x + inv(1, 1) * p.y + inv(1, 2) * p.z + inv(1, 3) * p.w;
+			q.z = inv(2, 0) * p.x + inv(2, 1) * p.y + inv(2, 2) * p.z + inv(2, 3) * p.w;
+			q.w = inv(3, 0) * p.x + inv(3, 1) * p.y + inv(3, 2) * p.z + inv(3, 3) * p.w;
+			
+			const float len = sqrtf(q.x * q.x + q.y * q.y + q.z * q.z);
+			if (len > 0) q /= len;
+		}
+	}
+	
+	// Gribb / Hartmann. `view_projection` is modelview * projection, clip
+	// coordinates are v * m, so every plane is column 3 +- column 0, 1, 2.
+	void setPlanes(const ofMatrix4x4& view_projection)
+	{
+		const ofMatrix4x4& m = view_projection;
+		
+		for (int i = 0; i < 6; i++)
+		{
+			const int axis = i / 2;
+			const float sign = (i & 1) ? -1 : 1;
+			
+			ofVec4f& p = planes[i];
+			p.x = m(0, 3) + sign * m(0, axis);
+			p.y = m(1, 3) + sign * m(1, axis);
+			p.z = m(2, 3) + sign * m(2, axis);
+			p.w = m(3, 3) + sign * m(3, axis);
+			
+			const float len = sqrtf(p.x * p.x + p.y * p.y + p.z * p.z);
+			if (len > 0) p /= len;
+		}
+	}
+	
+	// left, right, bottom, top, near, far
+	const ofVec4f& getPlane(int i) const { return planes[i]; }
+	
+	bool isVisible(const ofVec3f& center, float radius) const
+	{
+		for (int i = 0; i < 6; i++)
+		{
+			const ofVec4f& p = planes[i];
+			if (p.x * center.x + p.y * center.y + p.z * center.z + p.w < -radius) return false;
+		}
+		
+		return true;
 	}
 	
+	// positive vertex test
+	bool isVisible(const Bounds& b) const
+	{
+		if (b.isEmpty()) return false;
+		
+		for (int i = 0; i < 6; i++)
+		{
+			const ofVec4f& p = planes[i];
+			
+			const float x = p.x >= 0 ? b.max.x : b.min.x;
+			const float y = p.y >= 0 ? b.max.y : b.min.y;
+			const float z = p.z >= 0 ? b.max.z : b.min.z;
+			
+			if (p.x * x + p.y * y + p.z * z + p.w < 0) return false;
+		}
+		
+		return true;
+	}
+	
+	// mask[i] becomes 1 for visible elements and 0 for culled ones, returns
+	// the number of visible elements
+	size_t cullSpheres(const float* x, const float* y, const float* z, const float* radius,
+					   size_t count, GLubyte* mask) const;
+	
+	size_t cullBoxes(const float* min_x, const float* min_y, const float* min_z,
+					 const float* max_x, const float* max_y, const float* max_z,
+					 size_t count, GLubyte* mask) const;
+
 protected:
 	
 	float near, far;
 	
 	ofVec3f points[8];
 	ofVec3f zero;
+	
+	ofVec4f planes[6];
 };
 
 OFX_OPENGL_PRIMITIVES_END_NAMESPACE
@@ -13,6 +13,7 @@ struct VertexArrayBinding
 	VertexArray *vao;
 	
 	Buffer* buffer;
+	GLuint buffer_handle;
 	
 	GLenum type;
 	GLint size;
@@ -23,23 +24,55 @@ struct VertexArrayBinding
 	
 	GLuint divisor;
 	
+	// the pointer only gets re-specified when something changed since
+	// the last enable()
+	bool dirty;
+	bool enabled;
+	
+	VertexArrayBinding()
+		: vao(NULL)
+		, buffer(NULL)
+		, buffer_handle(0)
+		, type(GL_FLOAT)
+		, size(0)
+		, normalized(GL_FALSE)
+		, offset(0)
+		, stride(0)
+		, divisor(0)
+		, dirty(true)
+		, enabled(false)
+	{}
+	
 	void setFormat(GLenum type, int size, GLboolean normalized = GL_FALSE)
 	{
+		if (this->type == type && this->size == size && this->normalized == normalized) return;
+		
 		this->type = type;
 		this->size = size;
 		this->normalized = normalized;
+		dirty = true;
 	}
 	
 	void setBuffer(Buffer* buffer, GLsizei offset, GLsizei stride = 0)
 	{
+		const GLuint handle = buffer ? buffer->getHandle() : 0;
+		
+		if (this->buffer == buffer && buffer_handle == handle
+			&& this->offset == offset && this->stride == stride) return;
+		
 		this->buffer = buffer;
+		this->buffer_handle = handle;
 		this->offset = offset;
 		this->stride = stride;
+		dirty = true;
 	}
 	
 	void setDivisor(GLuint divisor)
 	{
+		if (this->divisor == divisor) return;
+		
 		this->divisor = divisor;
+		dirty = true;
 	}
 	
 	void enable(GLuint location);
@@ -77,6 +110,52 @@ public:
 		glBindVertexArray(NULL);
 	}
 	
+	// ARB_vertex_attrib_binding (GL 4.3): the format lives in the VAO and
+	// refers to a binding index, buffers are attached to the binding index
+	// separately so one VAO can serve every buffer with the same layout.
+	
+	void setAttribFormat(GLuint location, GLint size, GLenum type, GLboolean normalized, GLuint relative_offset, GLuint binding_index)
+	{
+		glVertexAttribFormat(location, size, type, normalized, relative_offset);
+		glVertexAttribBinding(location, binding_index);
+		glEnableVertexAttribArray(location);
+	}
+	
+	void bindVertexBuffer(GLuint binding_index, Buffer* buffer, GLintptr offset, GLsizei stride)
+	{
+		glBindVertexBuffer(binding_index, buffer->getHandle(), offset, stride);
+	}
+	
+	void setBindingDivisor(GLuint binding_index, GLuint divisor)
+	{
+		glVertexBindingDivisor(binding_index, divisor);
+	}
+	
+	static bool isAttribBindingSupported()
+	{
+		static int supported = -1;
+		
+		if (supported < 0)
+		{
+			GLint major = 0, minor = 0;
+			glGetIntegerv(GL_MAJOR_VERSION, &major);
+			glGetIntegerv(GL_MINOR_VERSION, &minor);
+			
+			supported = major > 4 || (major == 4 && minor >= 3);
+			
+			GLint num_extensions = 0;
+			glGetIntegerv(GL_NUM_EXTENSIONS, &num_extensions);
+			
+			for (GLint i = 0; i < num_extensions && !supported; i++)
+			{
+				const GLubyte* name = glGetStringi(GL_EXTENSIONS, i);
+				supported = name && strcmp((const char*)name, "GL_ARB_vertex_attrib_binding") == 0;
+			}
+		}
+		
+		return supported;
+	}
+	
 protected:
 	
 	GLuint handle;
@@ -84,15 +163,70 @@ protected:
 	map<GLuint, VertexArrayBinding> bindings;
 };
 
+#pragma mark - SharedVertexArrays
+
+// owns the VAOs of Geometry_::setSharedVertexArray(), one per layout.
+// VAOs can't be shared between GL contexts, so they are kept per context:
+// apps drawing from several contexts call setContext() with any key that
+// identifies the current one. call release() while the context is still
+// current, e.g. from ofApp::exit(). VAOs that are never released are
+// leaked instead of deleted after the context is gone.
+class SharedVertexArrays
+{
+public:
+
+	typedef const void* Key;
+	
+	static void setContext(Key context) { getCurrentContext() = context; }
+	static Key getContext() { return getCurrentContext(); }
+	
+	// `created` tells the caller to set up the formats
+	static VertexArray& get(Key layout, bool& created)
+	{
+		VertexArray*& vao = getContexts()[getCurrentContext()][layout];
+		
+		created = vao == NULL;
+		if (created) vao = new VertexArray;
+		
+		return *vao;
+	}
+	
+	// delete the VAOs of the current context, they are recreated on use
+	static void release()
+	{
+		map<Key, Layouts>& contexts = getContexts();
+		map<Key, Layouts>::iterator it = contexts.find(getCurrentContext());
+		
+		if (it == contexts.end()) return;
+		
+		for (Layouts::iterator v = it->second.begin(); v != it->second.end(); v++)
+			delete v->second;
+		
+		contexts.erase(it);
+	}
+
+protected:
+
+	typedef map<Key, VertexArray*> Layouts;
+	
+	static map<Key, Layouts>& getContexts() { static map<Key, Layouts> contexts; return contexts; }
+	static Key& getCurrentContext() { static Key context = NULL; return context; }
+};
+
 ///
 
-void VertexArrayBinding::enable(GLuint location)
+inline void VertexArrayBinding::enable(GLuint location)
 {
+	if (enabled && !dirty) return;
+	
 	buffer->bind();
 	
 	glVertexAttribPointer(location, size, type, normalized, stride, (GLvoid*)offset);
 	glEnableVertexAttribArray(location);
 	glVertexAttribDivisor(location, divisor);
+	
+	dirty = false;
+	enabled = true;
 }
 
 OFX_OPENGL_PRIMITIVES_END_NAMESPACE
\ No newline at end of file
@@ -1,11 +1,28 @@
 #pragma once
 
 #include "ofxOpenGLPrimitives/VertexArray.h"
+#include "ofxOpenGLPrimitives/GeometryImage.h"
 
 #include "detail/VertexArray.inc.h"
 
 OFX_OPENGL_PRIMITIVES_BEGIN_NAMESPACE
 
+namespace VertexLayout {
+
+// one contiguous block per attribute (SoA)
+struct Separate
+{
+	enum { IsInterleaved = 0 };
+};
+
+// all attributes of a vertex packed into one strided record (AoS)
+struct Interleaved
+{
+	enum { IsInterleaved = 1 };
+};
+
+}
+
 template <
 	typename T0 = detail::NullType0,
 	typename T1 = detail::NullType1,
@@ -14,7 +31,8 @@ template <
 	typename T4 = detail::NullType4,
 	typename T5 = detail::NullType5,
 	typename T6 = detail::NullType6,
-	typename T7 = detail::NullType7
+	typename T7 = detail::NullType7,
+	typename Layout = VertexLayout::Separate
 >
 class VertexAttribute_
 	: public T0
@@ -32,14 +50,108 @@ public:
 		: num_vertices(0)
 		, usage(GL_STATIC_DRAW)
 		, divisor(0)
+		, stream_buffer(NULL)
+		, stream_offset(0)
 	{}
 	
 	void begin();
 	void end();
+	void end(StreamBuffer& stream);
 	void push();
 	
+	void reserve(size_t n);
+	
+	// bulk version of push(), copies `count` elements from each array.
+	// attributes given as NULL repeat their current value.
+	void append(size_t count,
+				const typename T0::value_type* a0 = NULL,
+				const typename T1::value_type* a1 = NULL,
+				const typename T2::value_type* a2 = NULL,
+				const typename T3::value_type* a3 = NULL,
+				const typename T4::value_type* a4 = NULL,
+				const typename T5::value_type* a5 = NULL,
+				const typename T6::value_type* a6 = NULL,
+				const typename T7::value_type* a7 = NULL);
+	
+	// re-upload vertices [first, first + count) of every attribute after
+	// editing them in place. the default flags skip the GPU sync, so the
+	// caller must make sure the range isn't being drawn from.
+	void update(size_t first, size_t count,
+				GLbitfield access = BufferMapAccess::WRITE | BufferMapAccess::INVALIDATE_RANGE | BufferMapAccess::UNSYNCHRONIZED);
+	
+	// random access edit of a built attribute, e.g. set<Vertex>(i, v).
+	// only the modified range of each attribute is uploaded by commit().
+	template <typename Attribute>
+	void set(size_t index, const typename Attribute::value_type& v) { Attribute::set(index, v); }
+	
+	template <typename Attribute>
+	const typename Attribute::value_type& get(size_t index) const { return Attribute::get(index); }
+	
+	void commit();
+	
+	// move vertex i to remap[i] in every attribute, vertices mapped to ~0
+	// are dropped. call end() again to upload the result.
+	void remap(const vector<GLuint>& remap, size_t new_num_vertices)
+	{
+		num_vertices = new_num_vertices;
+		
+		T0::remap(remap, new_num_vertices);
+		T1::remap(remap, new_num_vertices);
+		T2::remap(remap, new_num_vertices);
+		T3::remap(remap, new_num_vertices);
+		T4::remap(remap, new_num_vertices);
+		T5::remap(remap, new_num_vertices);
+		T6::remap(remap, new_num_vertices);
+		T7::remap(remap, new_num_vertices);
+	}
+	
+	// keep the vertices of `src` whose mask is set, e.g. the visible
+	// instances from Frustum::cullSpheres(). `src` may be *this. call end()
+	// to upload the result.
+	void compact(const VertexAttribute_& src, const GLubyte* mask)
+	{
+		size_t n = 0;
+		for (size_t i = 0; i < src.num_vertices; i++) n += mask[i] != 0;
+		
+		T0::compact(static_cast<const T0&>(src), mask);
+		T1::compact(static_cast<const T1&>(src), mask);
+		T2::compact(static_cast<const T2&>(src), mask);
+		T3::compact(static_cast<const T3&>(src), mask);
+		T4::compact(static_cast<const T4&>(src), mask);
+		T5::compact(static_cast<const T5&>(src), mask);
+		T6::compact(static_cast<const T6&>(src), mask);
+		T7::compact(static_cast<const T7&>(src), mask);
+		
+		num_vertices = n;
+	}
+	
+	// snapshot of the built vertices, see GeometryImage. begin(), push(),
+	// append() and bake() don't touch GL, so a mesh can be built and baked
+	// on a worker thread and handed to upload() on the GL thread.
+	void bake(GeometryImage& image) { bakeImage(image, GL_POINTS, NULL, 0); }
+	
+	// replace the vertices with the ones in `image` and upload them as is.
+	// fails if the image was saved from a different attribute layout.
+	bool upload(const GeometryImage& image) { return readImage(image); }
+	
+	bool save(const string& path)
+	{
+		GeometryImage image;
+		bake(image);
+		return image.save(path);
+	}
+	
+	bool load(const string& path)
+	{
+		GeometryImage image;
+		return image.load(path) && upload(image);
+	}
+	
 	size_t getNumVertices() const { return num_vertices; }
 	
+	void setUsage(GLenum usage) { this->usage = usage; }
+	GLenum getUsage() const { return usage; }
+	
 	void setDivisor(GLuint n) { divisor = n; }
 	GLuint getDivisor() const { return divisor; }
 
@@ -52,6 +164,12 @@ protected:
 	
 	ofPtr<Buffer> vertex_buffer;
 	
+	StreamBuffer* stream_buffer;
+	GLintptr stream_offset;
+	
+	// staging records for the interleaved layout
+	vector<GLubyte> interleaved;
+	
 	static size_t getStride()
 	{
 		return sizeof(typename T0::value_type)
@@ -78,40 +196,227 @@ protected:
 		T7::reset();
 	}
 	
+	void clearDirty()
+	{
+		T0::clearDirty();
+		T1::clearDirty();
+		T2::clearDirty();
+		T3::clearDirty();
+		T4::clearDirty();
+		T5::clearDirty();
+		T6::clearDirty();
+		T7::clearDirty();
+	}
+	
+	// pack vertices [first, first + count) into strided records
+	void interleave(GLubyte* dst, size_t first, size_t count)
+	{
+		const size_t stride = getStride();
+		size_t offset = 0;
+		
+		T0::interleave(dst, offset, stride, first, count);
+		T1::interleave(dst, offset, stride, first, count);
+		T2::interleave(dst, offset, stride, first, count);
+		T3::interleave(dst, offset, stride, first, count);
+		T4::interleave(dst, offset, stride, first, count);
+		T5::interleave(dst, offset, stride, first, count);
+		T6::interleave(dst, offset, stride, first, count);
+		T7::interleave(dst, offset, stride, first, count);
+	}
+	
+	GLubyte* interleave(size_t first, size_t count)
+	{
+		interleaved.resize(getStride() * count);
+		if (interleaved.empty()) return NULL;
+		
+		interleave(interleaved.data(), first, count);
+		return interleaved.data();
+	}
+	
+	// bind the own vertex buffer with room for num_vertices
+	Buffer* allocate()
+	{
+		stream_buffer = NULL;
+		stream_offset = 0;
+		
+		if (!vertex_buffer)
+			vertex_buffer = ofPtr<Buffer>(new Buffer(GL_ARRAY_BUFFER));
+		
+		vertex_buffer->bind();
+		
+		// reuse the storage across rebuilds, only grow when it doesn't fit
+		if (!vertex_buffer->reserve(getStride() * num_vertices, usage))
+			vertex_buffer->orphan();
+		
+		return vertex_buffer.get();
+	}
+	
+	void describe(vector<GeometryImage::Attribute>& attributes) const
+	{
+		size_t offset = 0;
+		
+		T0::describe(attributes, offset, num_vertices, Layout::IsInterleaved);
+		T1::describe(attributes, offset, num_vertices, Layout::IsInterleaved);
+		T2::describe(attributes, offset, num_vertices, Layout::IsInterleaved);
+		T3::describe(attributes, offset, num_vertices, Layout::IsInterleaved);
+		T4::describe(attributes, offset, num_vertices, Layout::IsInterleaved);
+		T5::describe(attributes, offset, num_vertices, Layout::IsInterleaved);
+		T6::describe(attributes, offset, num_vertices, Layout::IsInterleaved);
+		T7::describe(attributes, offset, num_vertices, Layout::IsInterleaved);
+	}
+	
+	void bakeImage(GeometryImage& image, GLenum mode, const GLuint* indices, size_t num_indices);
+	bool readImage(const GeometryImage& image);
+	
 public:
 	
 	void bind(VertexArray* vao)
 	{
-		vertex_buffer->bind();
+		Buffer* vbo = stream_buffer ? stream_buffer : vertex_buffer.get();
+		vbo->bind();
+		
+		size_t offset = stream_buffer ? stream_offset : 0;
 		
+		if (Layout::IsInterleaved)
+		{
+			const GLsizei stride = getStride();
+			
+			T0::bindInterleaved(vao, vbo, offset, stride, divisor);
+			T1::bindInterleaved(vao, vbo, offset, stride, divisor);
+			T2::bindInterleaved(vao, vbo, offset, stride, divisor);
+			T3::bindInterleaved(vao, vbo, offset, stride, divisor);
+			T4::bindInterleaved(vao, vbo, offset, stride, divisor);
+			T5::bindInterleaved(vao, vbo, offset, stride, divisor);
+			T6::bindInterleaved(vao, vbo, offset, stride, divisor);
+			T7::bindInterleaved(vao, vbo, offset, stride, divisor);
+			
+			return;
+		}
+		
+		T0::bind(vao, vbo, offset, divisor);
+		T1::bind(vao, vbo, offset, divisor);
+		T2::bind(vao, vbo, offset, divisor);
+		T3::bind(vao, vbo, offset, divisor);
+		T4::bind(vao, vbo, offset, divisor);
+		T5::bind(vao, vbo, offset, divisor);
+		T6::bind(vao, vbo, offset, divisor);
+		T7::bind(vao, vbo, offset, divisor);
+	}
+	
+	// the format half of bind() for a VAO shared by every VertexAttribute_
+	// with this layout, see VertexArray::setAttribFormat()
+	static void bindFormat(VertexArray* vao)
+	{
+		if (Layout::IsInterleaved)
+		{
+			size_t offset = 0;
+			
+			T0::bindFormatInterleaved(vao, T0::Location, offset);
+			T1::bindFormatInterleaved(vao, T0::Location, offset);
+			T2::bindFormatInterleaved(vao, T0::Location, offset);
+			T3::bindFormatInterleaved(vao, T0::Location, offset);
+			T4::bindFormatInterleaved(vao, T0::Location, offset);
+			T5::bindFormatInterleaved(vao, T0::Location, offset);
+			T6::bindFormatInterleaved(vao, T0::Location, offset);
+			T7::bindFormatInterleaved(vao, T0::Location, offset);
+			
+			return;
+		}
+		
+		T0::bindFormat(vao);
+		T1::bindFormat(vao);
+		T2::bindFormat(vao);
+		T3::bindFormat(vao);
+		T4::bindFormat(vao);
+		T5::bindFormat(vao);
+		T6::bindFormat(vao);
+		T7::bindFormat(vao);
+	}
+	
+	// attach the vertex buffer to the GL_TRANSFORM_FEEDBACK_BUFFER binding
+	// points of the bound TransformFeedback: one binding for the
+	// interleaved layout, one per attribute starting at `first_index` for
+	// the separate layout. only GL_FLOAT attributes can be captured, others
+	// don't compile. call end() first to size the buffer. captured
+	// vertices only live on the GPU, the CPU copy and the bounds keep the
+	// values of the last end().
+	void bindTransformFeedbackBuffers(GLuint first_index = 0)
+	{
+		if (!vertex_buffer || stream_buffer)
+		{
+			ofLogError("VertexAttribute_") << "transform feedback needs the own vertex buffer, call end() first";
+			return;
+		}
+		
+		if (num_vertices == 0) return;
+		
+		Buffer* vbo = vertex_buffer.get();
+		
+		if (Layout::IsInterleaved)
+		{
+			vbo->bindRange(GL_TRANSFORM_FEEDBACK_BUFFER, first_index, 0, getStride() * num_vertices);
+			return;
+		}
+		
+		GLuint index = first_index;
 		size_t offset = 0;
 		
-		T0::bind(vao, vertex_buffer.get(), offset, divisor);
-		T1::bind(vao, vertex_buffer.get(), offset, divisor);
-		T2::bind(vao, vertex_buffer.get(), offset, divisor);
-		T3::bind(vao, vertex_buffer.get(), offset, divisor);
-		T4::bind(vao, vertex_buffer.get(), offset, divisor);
-		T5::bind(vao, vertex_buffer.get(), offset, divisor);
-		T6::bind(vao, vertex_buffer.get(), offset, divisor);
-		T7::bind(vao, vertex_buffer.get(), offset, divisor);
+		T0::bindFeedback(vbo, index, offset, num_vertices);
+		T1::bindFeedback(vbo, index, offset, num_vertices);
+		T2::bindFeedback(vbo, index, offset, num_vertices);
+		T3::bindFeedback(vbo, index, offset, num_vertices);
+		T4::bindFeedback(vbo, index, offset, num_vertices);
+		T5::bindFeedback(vbo, index, offset, num_vertices);
+		T6::bindFeedback(vbo, index, offset, num_vertices);
+		T7::bindFeedback(vbo, index, offset, num_vertices);
+	}
+	
+	// the buffer half, attaches this vertex buffer to the bound shared VAO
+	void bindBuffers(VertexArray* vao)
+	{
+		Buffer* vbo = stream_buffer ? stream_buffer : vertex_buffer.get();
+		size_t offset = stream_buffer ? stream_offset : 0;
+		
+		if (Layout::IsInterleaved)
+		{
+			// interleaved records share the binding index of the first attribute
+			vao->bindVertexBuffer(T0::Location, vbo, offset, getStride());
+			vao->setBindingDivisor(T0::Location, divisor);
+			return;
+		}
+		
+		T0::bindBuffer(vao, vbo, offset, divisor);
+		T1::bindBuffer(vao, vbo, offset, divisor);
+		T2::bindBuffer(vao, vbo, offset, divisor);
+		T3::bindBuffer(vao, vbo, offset, divisor);
+		T4::bindBuffer(vao, vbo, offset, divisor);
+		T5::bindBuffer(vao, vbo, offset, divisor);
+		T6::bindBuffer(vao, vbo, offset, divisor);
+		T7::bindBuffer(vao, vbo, offset, divisor);
 	}
 };
 
 //
 
-template <typename T0, typename T1, typename T2, typename T3, typename T4, typename T5, typename T6, typename T7>
-inline void VertexAttribute_<T0, T1, T2, T3, T4, T5, T6, T7>::begin()
+template <typename T0, typename T1, typename T2, typename T3, typename T4, typename T5, typename T6, typename T7, typename Layout>
+inline void VertexAttribute_<T0, T1, T2, T3, T4, T5, T6, T7, Layout>::begin()
 {
 	reset();
 }
 
-template <typename T0, typename T1, typename T2, typename T3, typename T4, typename T5, typename T6, typename T7>
-inline void VertexAttribute_<T0, T1, T2, T3, T4, T5, T6, T7>::end()
+template <typename T0, typename T1, typename T2, typename T3, typename T4, typename T5, typename T6, typename T7, typename Layout>
+inline void VertexAttribute_<T0, T1, T2, T3, T4, T5, T6, T7, Layout>::end()
 {
-	vertex_buffer = ofPtr<Buffer>(new Buffer(GL_ARRAY_BUFFER));
+	allocate();
 	
-	vertex_buffer->bind();
-	vertex_buffer->allocate(getStride() * num_vertices, usage);
+	if (Layout::IsInterleaved)
+	{
+		GLubyte* records = interleave(0, num_vertices);
+		if (records) vertex_buffer->setSubData(records, 0, getStride() * num_vertices);
+		
+		clearDirty();
+		return;
+	}
 	
 	size_t offset = 0;
 	
@@ -125,8 +430,232 @@ inline void VertexAttribute_<T0, T1, T2, T3, T4, T5, T6, T7>::end()
 	T7::upload(vertex_buffer.get(), offset);
 }
 
-template <typename T0, typename T1, typename T2, typename T3, typename T4, typename T5, typename T6, typename T7>
-inline void VertexAttribute_<T0, T1, T2, T3, T4, T5, T6, T7>::push()
+template <typename T0, typename T1, typename T2, typename T3, typename T4, typename T5, typename T6, typename T7, typename Layout>
+inline void VertexAttribute_<T0, T1, T2, T3, T4, T5, T6, T7, Layout>::end(StreamBuffer& stream)
+{
+	GLintptr offset = 0;
+	GLubyte* dst = stream.acquire(getStride() * num_vertices, offset);
+	
+	if (dst == NULL)
+	{
+		ofLogError("VertexAttribute_") << "stream buffer region is full, falling back to own buffer";
+		end();
+		return;
+	}
+	
+	stream_buffer = &stream;
+	stream_offset = offset;
+	
+	if (Layout::IsInterleaved)
+	{
+		interleave(dst, 0, num_vertices);
+		return;
+	}
+	
+	size_t cursor = 0;
+	
+	T0::write(dst, cursor);
+	T1::write(dst, cursor);
+	T2::write(dst, cursor);
+	T3::write(dst, cursor);
+	T4::write(dst, cursor);
+	T5::write(dst, cursor);
+	T6::write(dst, cursor);
+	T7::write(dst, cursor);
+}
+
+template <typename T0, typename T1, typename T2, typename T3, typename T4, typename T5, typename T6, typename T7, typename Layout>
+inline void VertexAttribute_<T0, T1, T2, T3, T4, T5, T6, T7, Layout>::bakeImage(GeometryImage& image, GLenum mode, const GLuint* indices, size_t num_indices)
+{
+	vector<GeometryImage::Attribute> attributes;
+	describe(attributes);
+	
+	const size_t num_bytes = getStride() * num_vertices;
+	vector<GLubyte> vertices(num_bytes);
+	
+	if (num_bytes)
+	{
+		if (Layout::IsInterleaved)
+		{
+			interleave(vertices.data(), 0, num_vertices);
+		}
+		else
+		{
+			size_t offset = 0;
+			
+			T0::write(vertices.data(), offset);
+			T1::write(vertices.data(), offset);
+			T2::write(vertices.data(), offset);
+			T3::write(vertices.data(), offset);
+			T4::write(vertices.data(), offset);
+			T5::write(vertices.data(), offset);
+			T6::write(vertices.data(), offset);
+			T7::write(vertices.data(), offset);
+		}
+	}
+	
+	image.assign(Layout::IsInterleaved, getStride(), attributes,
+				 num_vertices, vertices.data(), num_bytes,
+				 mode, indices, num_indices);
+}
+
+template <typename T0, typename T1, typename T2, typename T3, typename T4, typename T5, typename T6, typename T7, typename Layout>
+inline bool VertexAttribute_<T0, T1, T2, T3, T4, T5, T6, T7, Layout>::readImage(const GeometryImage& image)
+{
+	if (!image.isValid()) return false;
+	
+	const GeometryImage::Header& header = image.getHeader();
+	
+	vector<GeometryImage::Attribute> attributes;
+	
+	const size_t n = num_vertices;
+	num_vertices = header.num_vertices;
+	describe(attributes);
+	num_vertices = n;
+	
+	bool match = header.interleaved == Layout::IsInterleaved
+		&& header.stride == getStride()
+		&& header.vertex_size == getStride() * header.num_vertices
+		&& header.num_attributes == attributes.size();
+	
+	for (size_t i = 0; match && i < attributes.size(); i++)
+		match = image.getAttributes()[i] == attributes[i];
+	
+	if (!match)
+	{
+		ofLogError("VertexAttribute_") << "geometry image has a different attribute layout";
+		return false;
+	}
+	
+	num_vertices = header.num_vertices;
+	
+	const GLubyte* src = image.getVertexData();
+	size_t offset = 0;
+	
+	if (Layout::IsInterleaved)
+	{
+		const size_t stride = getStride();
+		
+		T0::deinterleave(src, offset, stride, num_vertices);
+		T1::deinterleave(src, offset, stride, num_vertices);
+		T2::deinterleave(src, offset, stride, num_vertices);
+		T3::deinterleave(src, offset, stride, num_vertices);
+		T4::deinterleave(src, offset, stride, num_vertices);
+		T5::deinterleave(src, offset, stride, num_vertices);
+		T6::deinterleave(src, offset, stride, num_vertices);
+		T7::deinterleave(src, offset, stride, num_vertices);
+	}
+	else
+	{
+		T0::read(src, offset, num_vertices);
+		T1::read(src, offset, num_vertices);
+		T2::read(src, offset, num_vertices);
+		T3::read(src, offset, num_vertices);
+		T4::read(src, offset, num_vertices);
+		T5::read(src, offset, num_vertices);
+		T6::read(src, offset, num_vertices);
+		T7::read(src, offset, num_vertices);
+	}
+	
+	// the image already is the buffer layout, upload it without repacking
+	Buffer* vbo = allocate();
+	if (header.vertex_size) vbo->setSubData(src, 0, header.vertex_size);
+	vbo->unbind();
+	
+	return true;
+}
+
+template <typename T0, typename T1, typename T2, typename T3, typename T4, typename T5, typename T6, typename T7, typename Layout>
+inline void VertexAttribute_<T0, T1, T2, T3, T4, T5, T6, T7, Layout>::update(size_t first, size_t count, GLbitfield access)
+{
+	if (!vertex_buffer || stream_buffer)
+	{
+		ofLogError("VertexAttribute_") << "update() needs a buffer built with end()";
+		return;
+	}
+	
+	if (first + count > num_vertices) count = first < num_vertices ? num_vertices - first : 0;
+	
+	if (Layout::IsInterleaved)
+	{
+		GLubyte* records = interleave(first, count);
+		
+		if (records)
+		{
+			ScopedMapping m(*vertex_buffer, first * getStride(), count * getStride(), access);
+			if (m.isValid()) memcpy(m.getPtr(), records, count * getStride());
+		}
+		
+		vertex_buffer->unbind();
+		return;
+	}
+	
+	size_t offset = 0;
+	
+	T0::update(vertex_buffer.get(), offset, first, count, access);
+	T1::update(vertex_buffer.get(), offset, first, count, access);
+	T2::update(vertex_buffer.get(), offset, first, count, access);
+	T3::update(vertex_buffer.get(), offset, first, count, access);
+	T4::update(vertex_buffer.get(), offset, first, count, access);
+	T5::update(vertex_buffer.get(), offset, first, count, access);
+	T6::update(vertex_buffer.get(), offset, first, count, access);
+	T7::update(vertex_buffer.get(), offset, first, count, access);
+	
+	vertex_buffer->unbind();
+}
+
+template <typename T0, typename T1, typename T2, typename T3, typename T4, typename T5, typename T6, typename T7, typename Layout>
+inline void VertexAttribute_<T0, T1, T2, T3, T4, T5, T6, T7, Layout>::commit()
+{
+	if (!vertex_buffer || stream_buffer)
+	{
+		ofLogError("VertexAttribute_") << "commit() needs a buffer built with end()";
+		return;
+	}
+	
+	vertex_buffer->bind();
+	
+	if (Layout::IsInterleaved)
+	{
+		// one upload spanning the union of the dirty ranges
+		size_t first = num_vertices, last = 0;
+		
+		T0::mergeDirty(first, last);
+		T1::mergeDirty(first, last);
+		T2::mergeDirty(first, last);
+		T3::mergeDirty(first, last);
+		T4::mergeDirty(first, last);
+		T5::mergeDirty(first, last);
+		T6::mergeDirty(first, last);
+		T7::mergeDirty(first, last);
+		
+		if (last > first)
+		{
+			GLubyte* records = interleave(first, last - first);
+			vertex_buffer->setSubData(records, first * getStride(), (last - first) * getStride());
+		}
+		
+		clearDirty();
+		vertex_buffer->unbind();
+		return;
+	}
+	
+	size_t offset = 0;
+	
+	T0::commit(vertex_buffer.get(), offset);
+	T1::commit(vertex_buffer.get(), offset);
+	T2::commit(vertex_buffer.get(), offset);
+	T3::commit(vertex_buffer.get(), offset);
+	T4::commit(vertex_buffer.get(), offset);
+	T5::commit(vertex_buffer.get(), offset);
+	T6::commit(vertex_buffer.get(), offset);
+	T7::commit(vertex_buffer.get(), offset);
+	
+	vertex_buffer->unbind();
+}
+
+template <typename T0, typename T1, typename T2, typename T3, typename T4, typename T5, typename T6, typename T7, typename Layout>
+inline void VertexAttribute_<T0, T1, T2, T3, T4, T5, T6, T7, Layout>::push()
 {
 	num_vertices++;
 	
@@ -140,4 +669,40 @@ inline void VertexAttribute_<T0, T1, T2, T3, T4, T5, T6, T7>::push()
 	T7::push();
 }
 
+template <typename T0, typename T1, typename T2, typename T3, typename T4, typename T5, typename T6, typename T7, typename Layout>
+inline void VertexAttribute_<T0, T1, T2, T3, T4, T5, T6, T7, Layout>::reserve(size_t n)
+{
+	T0::reserve(n);
+	T1::reserve(n);
+	T2::reserve(n);
+	T3::reserve(n);
+	T4::reserve(n);
+	T5::reserve(n);
+	T6::reserve(n);
+	T7::reserve(n);
+}
+
+template <typename T0, typename T1, typename T2, typename T3, typename T4, typename T5, typename T6, typename T7, typename Layout>
+inline void VertexAttribute_<T0, T1, T2, T3, T4, T5, T6, T7, Layout>::append(size_t count,
+	const typename T0::value_type* a0,
+	const typename T1::value_type* a1,
+	const typename T2::value_type* a2,
+	const typename T3::value_type* a3,
+	const typename T4::value_type* a4,
+	const typename T5::value_type* a5,
+	const typename T6::value_type* a6,
+	const typename T7::value_type* a7)
+{
+	num_vertices += count;
+	
+	T0::append(a0, count);
+	T1::append(a1, count);
+	T2::append(a2, count);
+	T3::append(a3, count);
+	T4::append(a4, count);
+	T5::append(a5, count);
+	T6::append(a6, count);
+	T7::append(a7, count);
+}
+
 OFX_OPENGL_PRIMITIVES_END_NAMESPACE
\ No newline at end of file
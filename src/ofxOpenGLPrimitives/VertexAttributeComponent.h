@@ -2,6 +2,8 @@
 
 #include "ofxOpenGLPrimitives/VertexAttribute.h"
 
+#include "detail/Quantize.inc.h"
+
 OFX_OPENGL_PRIMITIVES_BEGIN_NAMESPACE
 
 struct NullAttribute {};
@@ -11,12 +13,53 @@ struct Attribute_;
 
 ///
 
+// keeps the bounds of its positions up to date while they are pushed,
+// appended or loaded. set() can only grow them, call updateBounds() to
+// shrink them again.
 struct Vertex : public Attribute_<0, ofVec3f, GL_FLOAT, 3>
 {
+	typedef Attribute_<0, ofVec3f, GL_FLOAT, 3> Attribute;
+	
 	static string getAttributeName() { return "position"; }
 	
 	void vertex(const ofVec3f& v) { value = v; }
 	void vertex(float x, float y, float z) { value.set(x, y, z); }
+	
+	const Bounds& getBounds() const { return bounds; }
+	
+	void updateBounds()
+	{
+		bounds.clear();
+		if (!buffer.empty()) bounds.add(buffer.data(), buffer.size());
+	}
+	
+	void reset() { Attribute::reset(); bounds.clear(); }
+	void push() { Attribute::push(); bounds.add(value); }
+	
+	void append(const value_type* src, size_t count)
+	{
+		Attribute::append(src, count);
+		
+		if (src) bounds.add(src, count);
+		else if (count) bounds.add(value);
+	}
+	
+	void set(size_t index, const value_type& v) { Attribute::set(index, v); bounds.add(v); }
+	
+	void remap(const vector<GLuint>& remap, size_t new_size) { Attribute::remap(remap, new_size); updateBounds(); }
+	void compact(const Vertex& src, const GLubyte* mask) { Attribute::compact(src, mask); updateBounds(); }
+	
+	void read(const GLubyte* src, size_t& offset, size_t count) { Attribute::read(src, offset, count); updateBounds(); }
+	
+	void deinterleave(const GLubyte* src, size_t& offset, size_t stride, size_t count)
+	{
+		Attribute::deinterleave(src, offset, stride, count);
+		updateBounds();
+	}
+
+protected:
+
+	Bounds bounds;
 };
 
 struct Normal : public Attribute_<1, ofVec3f, GL_FLOAT, 3>
@@ -51,4 +94,86 @@ struct TexCoord0 : public Attribute_<6, ofVec2f, GL_FLOAT, 2>
 	void texCoord0(float x, float y) { value.set(x, y); }
 };
 
+/// compressed attributes
+
+// GL_HALF_FLOAT texcoords, 4 bytes instead of 8
+struct HalfTexCoord0 : public Attribute_<6, detail::Half2, GL_HALF_FLOAT, 2>
+{
+	static string getAttributeName() { return "texcoord0"; }
+	
+	void texCoord0(const ofVec2f& v) { value = detail::quantizeHalf2(v.x, v.y); }
+	void texCoord0(float x, float y) { value = detail::quantizeHalf2(x, y); }
+};
+
+// normalized GL_SHORT positions, 8 bytes instead of 12. the positions are
+// stored relative to the bounds given to setQuantizationBounds(), the
+// shader restores them with
+//
+//	uniform vec3 position_scale;
+//	uniform vec3 position_offset;
+//	...
+//	vec4(position.xyz * position_scale + position_offset, 1.0)
+//
+// with the uniforms set by setDequantizationUniforms(). w is stored as 1.0.
+struct QuantizedVertex : public Attribute_<0, detail::Snorm16x4, GL_SHORT, 4, true>
+{
+	static string getAttributeName() { return "position"; }
+	
+	QuantizedVertex() : offset(0, 0, 0), scale(1, 1, 1), inv_scale(1, 1, 1) {}
+	
+	// call before pushing vertices, everything outside is clamped
+	void setQuantizationBounds(const ofVec3f& min, const ofVec3f& max)
+	{
+		offset = (min + max) * 0.5;
+		scale = (max - min) * 0.5;
+		
+		for (int i = 0; i < 3; i++)
+			inv_scale[i] = scale[i] > 0 ? 1.0 / scale[i] : 0;
+	}
+	
+	const ofVec3f& getDequantizationScale() const { return scale; }
+	const ofVec3f& getDequantizationOffset() const { return offset; }
+	
+	// set position_scale and position_offset on a program in use
+	template <typename Program>
+	void setDequantizationUniforms(Program& program) const
+	{
+		program.setUniform("position_scale", scale);
+		program.setUniform("position_offset", offset);
+	}
+	
+	void vertex(const ofVec3f& v) { vertex(v.x, v.y, v.z); }
+	void vertex(float x, float y, float z)
+	{
+		value = detail::quantizeSnorm16x4((x - offset.x) * inv_scale.x,
+										  (y - offset.y) * inv_scale.y,
+										  (z - offset.z) * inv_scale.z);
+	}
+	
+protected:
+	
+	ofVec3f offset, scale, inv_scale;
+};
+
+// GL_INT_2_10_10_10_REV normals, 4 bytes instead of 12
+struct PackedNormal : public Attribute_<1, GLuint, GL_INT_2_10_10_10_REV, 4, true>
+{
+	static string getAttributeName() { return "normal"; }
+	
+	void normal(const ofVec3f& v) { value = detail::quantizeSnorm2_10_10_10(v.x, v.y, v.z); }
+	void normal(float x, float y, float z) { value = detail::quantizeSnorm2_10_10_10(x, y, z); }
+};
+
+// GL_INT_2_10_10_10_REV tangents, w holds the bitangent sign
+struct PackedTangent : public Attribute_<3, GLuint, GL_INT_2_10_10_10_REV, 4, true>
+{
+	static string getAttributeName() { return "tangent"; }
+	
+	void tangent(const ofVec3f& v, float handedness = 1) { tangent(v.x, v.y, v.z, handedness); }
+	void tangent(float x, float y, float z, float handedness = 1)
+	{
+		value = detail::quantizeSnorm2_10_10_10(x, y, z, handedness < 0 ? -1 : 1);
+	}
+};
+
 OFX_OPENGL_PRIMITIVES_END_NAMESPACE
\ No newline at end of file
@@ -0,0 +1,136 @@
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define OFX_OPENGL_PRIMITIVES_USE_SSE2
+#include <emmintrin.h>
+#endif
+
+#if defined(__F16C__)
+#include <immintrin.h>
+#endif
+
+OFX_OPENGL_PRIMITIVES_BEGIN_NAMESPACE
+
+namespace detail {
+
+struct Half2
+{
+	GLhalf x, y;
+};
+
+struct Snorm16x4
+{
+	GLshort x, y, z, w;
+};
+
+inline GLhalf floatToHalf(float f)
+{
+#if defined(__F16C__)
+	return _cvtss_sh(f, 0);
+#else
+	union { float f; GLuint u; } v;
+	v.f = f;
+	
+	const GLuint sign = (v.u >> 16) & 0x8000;
+	const GLuint abs = v.u & 0x7FFFFFFF;
+	
+	// overflow, inf and nan
+	if (abs >= 0x47800000)
+		return sign | (abs > 0x7F800000 ? 0x7E00 : 0x7C00);
+	
+	// subnormal half
+	if (abs < 0x38800000)
+	{
+		if (abs < 0x33000000) return sign;
+		
+		const GLuint e = abs >> 23;
+		const GLuint m = (abs & 0x7FFFFF) | 0x800000;
+		const GLuint shift = 126 - e;
+		
+		GLuint h = m >> shift;
+		if ((m >> (shift - 1)) & 1) h++;
+		
+		return sign | h;
+	}
+	
+	// rebias the exponent, round to nearest
+	GLuint h = (abs - 0x38000000) >> 13;
+	if (abs & 0x1000) h++;
+	
+	return sign | h;
+#endif
+}
+
+inline Half2 quantizeHalf2(float x, float y)
+{
+	Half2 h;
+	
+#if defined(__F16C__)
+	const __m128i v = _mm_cvtps_ph(_mm_set_ps(0, 0, y, x), 0);
+	const int packed = _mm_cvtsi128_si32(v);
+	h.x = packed & 0xFFFF;
+	h.y = (packed >> 16) & 0xFFFF;
+#else
+	h.x = floatToHalf(x);
+	h.y = floatToHalf(y);
+#endif
+	
+	return h;
+}
+
+// maps x, y, z, w in [-1, 1] to normalized GL_SHORT. w defaults to 1 so
+// the attribute reads as a point in a vec4
+inline Snorm16x4 quantizeSnorm16x4(float x, float y, float z, float w = 1)
+{
+	Snorm16x4 s;
+	
+#if defined(OFX_OPENGL_PRIMITIVES_USE_SSE2)
+	__m128 v = _mm_set_ps(w, z, y, x);
+	v = _mm_min_ps(_mm_max_ps(v, _mm_set1_ps(-1)), _mm_set1_ps(1));
+	v = _mm_mul_ps(v, _mm_set1_ps(32767));
+	
+	const __m128i i = _mm_cvtps_epi32(v);
+	_mm_storel_epi64((__m128i*)&s, _mm_packs_epi32(i, i));
+#else
+	const float v[4] = { x, y, z, w };
+	GLshort* dst = &s.x;
+	
+	for (int i = 0; i < 4; i++)
+	{
+		const float c = std::min(std::max(v[i], -1.0f), 1.0f) * 32767.0f;
+		dst[i] = (GLshort)(c < 0 ? c - 0.5f : c + 0.5f);
+	}
+#endif
+	
+	return s;
+}
+
+// GL_INT_2_10_10_10_REV, x, y, z in [-1, 1], w in {-1, 0, 1}
+inline GLuint quantizeSnorm2_10_10_10(float x, float y, float z, float w = 0)
+{
+	GLint q[4];
+	
+#if defined(OFX_OPENGL_PRIMITIVES_USE_SSE2)
+	__m128 v = _mm_set_ps(w, z, y, x);
+	v = _mm_min_ps(_mm_max_ps(v, _mm_set1_ps(-1)), _mm_set1_ps(1));
+	v = _mm_mul_ps(v, _mm_set_ps(1, 511, 511, 511));
+	
+	_mm_storeu_si128((__m128i*)q, _mm_cvtps_epi32(v));
+#else
+	const float v[4] = { x, y, z, w };
+	const float scale[4] = { 511, 511, 511, 1 };
+	
+	for (int i = 0; i < 4; i++)
+	{
+		const float c = std::min(std::max(v[i], -1.0f), 1.0f) * scale[i];
+		q[i] = (GLint)(c < 0 ? c - 0.5f : c + 0.5f);
+	}
+#endif
+	
+	return ((GLuint)q[0] & 0x3FF)
+		| (((GLuint)q[1] & 0x3FF) << 10)
+		| (((GLuint)q[2] & 0x3FF) << 20)
+		| (((GLuint)q[3] & 0x3) << 30);
+}
+
+}
+
+OFX_OPENGL_PRIMITIVES_END_NAMESPACE
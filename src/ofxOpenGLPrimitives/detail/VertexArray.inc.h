@@ -3,7 +3,26 @@ OFX_OPENGL_PRIMITIVES_BEGIN_NAMESPACE
 namespace detail {
 	
 typedef int NullData[0];
+
+// FNV-1a
+inline GLuint hashBytes(const void* data, size_t num_bytes, GLuint h = 2166136261u)
+{
+	const GLubyte* p = (const GLubyte*)data;
+	
+	for (size_t i = 0; i < num_bytes; i++)
+		h = (h ^ p[i]) * 16777619u;
 	
+	return h;
+}
+	
+// only defined for attributes transform feedback can write, see
+// Attribute_::IsCapturable
+template <bool IsCapturable>
+struct TransformFeedbackAttributeMustBeFloat;
+
+template <>
+struct TransformFeedbackAttributeMustBeFloat<true> {};
+
 }
 
 template <
@@ -18,18 +37,197 @@ struct Attribute_ {
 	value_type value;
 
 	enum {
-		Location = Location_
+		Location = Location_,
+		
+		// transform feedback only writes 32-bit float components
+		IsCapturable = GLType == GL_FLOAT
 	};
 
 	vector<value_type> buffer;
+	
+	// [dirty_begin, dirty_end) vertices modified by set() since the last upload
+	size_t dirty_begin, dirty_end;
+	
+	Attribute_() : dirty_begin(0), dirty_end(0) {}
 
-	void reset() { buffer.clear(); }
+	void reset() { buffer.clear(); dirty_begin = dirty_end = 0; }
 	void push() { buffer.push_back(value); }
+	
+	void reserve(size_t n) { buffer.reserve(n); }
+	
+	// copy `count` elements at once, repeats the current value if src is NULL
+	void append(const value_type* src, size_t count)
+	{
+		if (src) buffer.insert(buffer.end(), src, src + count);
+		else buffer.resize(buffer.size() + count, value);
+	}
+	
+	void set(size_t index, const value_type& v)
+	{
+		buffer[index] = v;
+		
+		if (dirty_begin == dirty_end)
+		{
+			dirty_begin = index;
+			dirty_end = index + 1;
+		}
+		else
+		{
+			dirty_begin = std::min(dirty_begin, index);
+			dirty_end = std::max(dirty_end, index + 1);
+		}
+	}
+	
+	const value_type& get(size_t index) const { return buffer[index]; }
+	
+	GLuint hash(size_t index, GLuint h) const
+	{
+		return detail::hashBytes(&buffer[index], sizeof(value_type), h);
+	}
+	
+	bool equal(size_t a, size_t b) const
+	{
+		return memcmp(&buffer[a], &buffer[b], sizeof(value_type)) == 0;
+	}
+	
+	// move element i to remap[i], elements mapped to ~0 are dropped. when
+	// several elements map to the same slot the first one is kept.
+	void remap(const vector<GLuint>& remap, size_t new_size)
+	{
+		vector<value_type> tmp(new_size);
+		
+		for (size_t i = remap.size(); i-- > 0;)
+		{
+			if (remap[i] != ~0u) tmp[remap[i]] = buffer[i];
+		}
+		
+		buffer.swap(tmp);
+		dirty_begin = dirty_end = 0;
+	}
+	
+	// keep the elements of `src` whose mask is set, `src` may be this
+	void compact(const Attribute_& src, const GLubyte* mask)
+	{
+		const size_t count = src.buffer.size();
+		size_t n = 0;
+		
+		if (&src != this) buffer.resize(count);
+		
+		for (size_t i = 0; i < count; i++)
+		{
+			if (mask[i]) buffer[n++] = src.buffer[i];
+		}
+		
+		buffer.erase(buffer.begin() + n, buffer.end());
+		dirty_begin = dirty_end = 0;
+	}
+	
+	void mergeDirty(size_t& first, size_t& last) const
+	{
+		if (dirty_begin == dirty_end) return;
+		
+		first = std::min(first, dirty_begin);
+		last = std::max(last, dirty_end);
+	}
+	
+	void clearDirty() { dirty_begin = dirty_end = 0; }
 
 	void upload(Buffer* dst, size_t& offset)
 	{
 		dst->setSubData(buffer.data(), offset, size());
 		offset += size();
+		
+		dirty_begin = dirty_end = 0;
+	}
+	
+	// upload only the range touched by set()
+	void commit(Buffer* dst, size_t& offset)
+	{
+		if (dirty_end > dirty_begin)
+		{
+			dst->setSubData(&buffer[dirty_begin],
+							offset + dirty_begin * sizeof(value_type),
+							(dirty_end - dirty_begin) * sizeof(value_type));
+		}
+		
+		offset += size();
+		
+		dirty_begin = dirty_end = 0;
+	}
+	
+	void write(GLubyte* dst, size_t& offset)
+	{
+		memcpy(dst + offset, buffer.data(), size());
+		offset += size();
+	}
+	
+	void update(Buffer* dst, size_t& offset, size_t first, size_t count, GLbitfield access)
+	{
+		const GLsizeiptr length = count * sizeof(value_type);
+		
+		if (length > 0)
+		{
+			ScopedMapping m(*dst, offset + first * sizeof(value_type), length, access);
+			if (m.isValid()) memcpy(m.getPtr(), &buffer[first], length);
+		}
+		
+		offset += size();
+	}
+
+	// scatter elements [first, first + count) into strided records
+	void interleave(GLubyte* dst, size_t& offset, size_t stride, size_t first, size_t count)
+	{
+		GLubyte* p = dst + offset;
+		
+		for (size_t i = 0; i < count; i++)
+		{
+			memcpy(p, &buffer[first + i], sizeof(value_type));
+			p += stride;
+		}
+		
+		offset += sizeof(value_type);
+	}
+
+	// copy `count` elements out of a block of the vertex image
+	void read(const GLubyte* src, size_t& offset, size_t count)
+	{
+		buffer.resize(count);
+		if (count) memcpy(buffer.data(), src + offset, count * sizeof(value_type));
+		
+		offset += count * sizeof(value_type);
+		dirty_begin = dirty_end = 0;
+	}
+	
+	// gather `count` elements out of strided records
+	void deinterleave(const GLubyte* src, size_t& offset, size_t stride, size_t count)
+	{
+		buffer.resize(count);
+		
+		const GLubyte* p = src + offset;
+		
+		for (size_t i = 0; i < count; i++)
+		{
+			memcpy(&buffer[i], p, sizeof(value_type));
+			p += stride;
+		}
+		
+		offset += sizeof(value_type);
+		dirty_begin = dirty_end = 0;
+	}
+	
+	void describe(vector<GeometryImage::Attribute>& attributes, size_t& offset, size_t count, bool interleaved) const
+	{
+		GeometryImage::Attribute a;
+		a.location = Location;
+		a.type = GLType;
+		a.num_components = NumComponents;
+		a.normalize = Normalize;
+		a.element_size = sizeof(value_type);
+		a.offset = offset;
+		
+		attributes.push_back(a);
+		
+		offset += interleaved ? sizeof(value_type) : count * sizeof(value_type);
 	}
 
 	void bind(VertexArray* vao, Buffer* vbo, size_t& offset, GLuint divisor)
@@ -43,7 +241,50 @@ struct Attribute_ {
 
 		offset += size();
 	}
+	
+	void bindInterleaved(VertexArray* vao, Buffer* vbo, size_t& offset, GLsizei stride, GLuint divisor)
+	{
+		VertexArrayBinding& binding = vao->getBindings(Location);
+		
+		binding.setFormat(GLType, NumComponents, Normalize);
+		binding.setBuffer(vbo, offset, stride);
+		binding.setDivisor(divisor);
+		binding.enable(Location);
+		
+		offset += sizeof(value_type);
+	}
+
+	// separate blocks use the location as binding index
+	static void bindFormat(VertexArray* vao)
+	{
+		vao->setAttribFormat(Location, NumComponents, GLType, Normalize, 0, Location);
+	}
+	
+	static void bindFormatInterleaved(VertexArray* vao, GLuint binding_index, size_t& offset)
+	{
+		vao->setAttribFormat(Location, NumComponents, GLType, Normalize, offset, binding_index);
+		offset += sizeof(value_type);
+	}
+	
+	void bindBuffer(VertexArray* vao, Buffer* vbo, size_t& offset, GLuint divisor)
+	{
+		vao->bindVertexBuffer(Location, vbo, offset, sizeof(value_type));
+		vao->setBindingDivisor(Location, divisor);
+		
+		offset += size();
+	}
 
+	// this attribute's block as the next transform feedback binding point
+	void bindFeedback(Buffer* vbo, GLuint& index, size_t& offset, size_t count)
+	{
+		(void)sizeof(detail::TransformFeedbackAttributeMustBeFloat<IsCapturable>);
+		
+		const GLsizeiptr num_bytes = count * sizeof(value_type);
+		
+		vbo->bindRange(GL_TRANSFORM_FEEDBACK_BUFFER, index++, offset, num_bytes);
+		offset += num_bytes;
+	}
+	
 	size_t size() const { return buffer.size() * sizeof(value_type); }
 };
 
@@ -53,8 +294,28 @@ struct Attribute_<Location, detail::NullData, GLType, NumComponents, Normalize>
 	vector<int> buffer;
 	void push() {}
 	void reset() {}
+	void reserve(size_t n) {}
+	void append(const value_type* src, size_t count) {}
 	void upload(Buffer* dst, size_t& offset) {}
+	void commit(Buffer* dst, size_t& offset) {}
+	void write(GLubyte* dst, size_t& offset) {}
+	void update(Buffer* dst, size_t& offset, size_t first, size_t count, GLbitfield access) {}
+	GLuint hash(size_t index, GLuint h) const { return h; }
+	bool equal(size_t a, size_t b) const { return true; }
+	void remap(const vector<GLuint>& remap, size_t new_size) {}
+	void compact(const Attribute_& src, const GLubyte* mask) {}
+	void mergeDirty(size_t& first, size_t& last) const {}
+	void clearDirty() {}
+	void interleave(GLubyte* dst, size_t& offset, size_t stride, size_t first, size_t count) {}
+	void read(const GLubyte* src, size_t& offset, size_t count) {}
+	void deinterleave(const GLubyte* src, size_t& offset, size_t stride, size_t count) {}
+	void describe(vector<GeometryImage::Attribute>& attributes, size_t& offset, size_t count, bool interleaved) const {}
 	void bind(VertexArray* vao, Buffer* vbo, size_t& offset, GLuint divisor) {}
+	void bindInterleaved(VertexArray* vao, Buffer* vbo, size_t& offset, GLsizei stride, GLuint divisor) {}
+	static void bindFormat(VertexArray* vao) {}
+	static void bindFormatInterleaved(VertexArray* vao, GLuint binding_index, size_t& offset) {}
+	void bindBuffer(VertexArray* vao, Buffer* vbo, size_t& offset, GLuint divisor) {}
+	void bindFeedback(Buffer* vbo, GLuint& index, size_t& offset, size_t count) {}
 };
 
 namespace detail {
@@ -28,6 +28,9 @@ public:
 	VertexAttribute_<InstancePosition, InstanceColor> per_instance_attr;
 	Geometry_<> model;
 	
+	vector<ofVec3f> positions;
+	vector<ofFloatColor> colors;
+	
 	Renderer_<
 		Program_<InstancePosition, InstanceColor>,
 		RendererCapability::ModelTransform,
@@ -48,6 +51,7 @@ public:
 		renderer.dumpInfo();
 
 		{
+			per_instance_attr.setUsage(GL_STREAM_DRAW);
 			per_instance_attr.begin();
 			
 			float s = 200;
@@ -85,22 +89,24 @@ public:
 	
 	void update()
 	{
-		per_instance_attr.begin();
-		
 		int N = 10000;
 		float s = 3000;
 		
 		float t = ofGetElapsedTimef() * 0.025;
 		
+		positions.resize(N);
+		colors.resize(N);
+		
 		for (int i = 0; i < N; i++)
 		{
-			per_instance_attr.position(ofSignedNoise(1, 0, 0, t + i * 0.01) * s,
-						  ofSignedNoise(0, 1, 0, t + i * 0.01) * s,
-						  ofSignedNoise(0, 0, 1, t + i * 0.01) * s);
-			per_instance_attr.color(ofColor::fromHsb(ofMap(i, 0, N, 0, 255), 255, 255));
-			per_instance_attr.push();
+			positions[i].set(ofSignedNoise(1, 0, 0, t + i * 0.01) * s,
+							 ofSignedNoise(0, 1, 0, t + i * 0.01) * s,
+							 ofSignedNoise(0, 0, 1, t + i * 0.01) * s);
+			colors[i] = ofColor::fromHsb(ofMap(i, 0, N, 0, 255), 255, 255);
 		}
 		
+		per_instance_attr.begin();
+		per_instance_attr.append(N, positions.data(), colors.data());
 		per_instance_attr.end();
 		
 		model.bindInstancedAttribute(per_instance_attr);
@@ -0,0 +1,27 @@
+
+
+--- vertex
+
+in vec3 position;
+in vec3 normal;
+in vec4 color;
+in vec2 texcoord0;
+
+out vec4 vs_color;
+
+void main(){
+	// touch every attribute so all of them are fetched
+	vec3 p = position + normal * 0.001 + vec3(texcoord0, 0.0) * 0.001;
+	gl_Position = vec4(p, 1);
+	vs_color = color;
+}
+
+--- fragment
+
+in vec4 vs_color;
+
+out vec4 frag_color;
+
+void main(){
+    frag_color = vs_color;
+}
@@ -0,0 +1,143 @@
+#include "ofMain.h"
+
+#include "ofxOpenGLPrimitives.h"
+
+using namespace ofxOpenGLPrimitives;
+
+// compares vertex fetch throughput of the separate (SoA) and interleaved
+// (AoS) VertexAttribute_ layouts. the meshes are drawn as points with
+// rasterization disabled, so the timer queries mostly measure the
+// vertex fetch and the vertex shader.
+
+typedef Geometry_<Normal, Color32f, TexCoord0> SeparateMesh;
+
+typedef Geometry_<
+	Normal, Color32f, TexCoord0,
+	detail::NullType3, detail::NullType4, detail::NullType5, detail::NullType6,
+	VertexLayout::Interleaved
+> InterleavedMesh;
+
+class ofApp : public ofBaseApp
+{
+public:
+	
+	ofxOpenGLPrimitives::ShaderLoader loader;
+	
+	Program_<Normal, Color32f, TexCoord0> program;
+	
+	SeparateMesh separate_mesh;
+	InterleavedMesh interleaved_mesh;
+	
+	GLuint queries[2];
+	double elapsed_ms[2];
+	
+	enum {
+		NUM_VERTICES = 4 * 1024 * 1024,
+		NUM_DRAWS = 8
+	};
+	
+	template <typename Mesh>
+	void build(Mesh& mesh)
+	{
+		ofSeedRandom(0);
+		
+		mesh.begin(GL_POINTS);
+		
+		for (int i = 0; i < NUM_VERTICES; i++)
+		{
+			mesh.normal(ofVec3f(ofRandom(-1, 1), ofRandom(-1, 1), ofRandom(-1, 1)).normalize());
+			mesh.color(ofRandom(1), ofRandom(1), ofRandom(1));
+			mesh.texCoord0(ofRandom(1), ofRandom(1));
+			mesh.vertex(ofRandom(-1, 1), ofRandom(-1, 1), ofRandom(-1, 1));
+		}
+		
+		mesh.end();
+	}
+	
+	template <typename Mesh>
+	void measure(Mesh& mesh, int index)
+	{
+		glBeginQuery(GL_TIME_ELAPSED, queries[index]);
+		
+		for (int i = 0; i < NUM_DRAWS; i++)
+			mesh.draw();
+		
+		glEndQuery(GL_TIME_ELAPSED);
+		
+		GLuint64 ns = 0;
+		glGetQueryObjectui64v(queries[index], GL_QUERY_RESULT, &ns);
+		
+		elapsed_ms[index] = elapsed_ms[index] * 0.9 + (ns / 1e6 / NUM_DRAWS) * 0.1;
+	}
+	
+	void setup()
+	{
+		ofSetFrameRate(0);
+		ofSetVerticalSync(false);
+		ofBackground(0);
+
+		loader.setVersion(400);
+		loader.load("layout", program);
+		
+		program.dumpInfo();
+		
+		build(separate_mesh);
+		build(interleaved_mesh);
+		
+		glGenQueries(2, queries);
+		elapsed_ms[0] = elapsed_ms[1] = 0;
+	}
+	
+	void exit()
+	{
+		glDeleteQueries(2, queries);
+	}
+	
+	void update()
+	{
+	}
+	
+	void draw()
+	{
+		program.use();
+		glEnable(GL_RASTERIZER_DISCARD);
+		
+		measure(separate_mesh, 0);
+		measure(interleaved_mesh, 1);
+		
+		glDisable(GL_RASTERIZER_DISCARD);
+		program.release();
+		
+		const double mvps[] = {
+			NUM_VERTICES / elapsed_ms[0] / 1000.0,
+			NUM_VERTICES / elapsed_ms[1] / 1000.0
+		};
+		
+		stringstream ss;
+		ss << "vertices: " << NUM_VERTICES << ", stride: 48 bytes" << endl;
+		ss << "separate (SoA):    " << ofToString(elapsed_ms[0], 3) << " ms / draw, " << ofToString(mvps[0], 1) << " Mvert/s" << endl;
+		ss << "interleaved (AoS): " << ofToString(elapsed_ms[1], 3) << " ms / draw, " << ofToString(mvps[1], 1) << " Mvert/s" << endl;
+		
+		ofDrawBitmapString(ss.str(), 10, 20);
+	}
+
+	void keyPressed(int key) {}
+	void keyReleased(int key) {}
+	
+	void mouseMoved(int x, int y) {}
+	void mouseDragged(int x, int y, int button) {}
+	void mousePressed(int x, int y, int button) {}
+	void mouseReleased(int x, int y, int button) {}
+	
+	void windowResized(int w, int h) {}
+};
+
+
+int main(int argc, const char** argv)
+{
+	ofSetCurrentRenderer(ofGLProgrammableRenderer::TYPE);
+	
+	ofSetupOpenGL(1280, 720, OF_WINDOW);
+	ofRunApp(new ofApp);
+	return 0;
+}